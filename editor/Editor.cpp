@@ -1,13 +1,20 @@
 #include "Editor.h"
 
-#include <io_backend/FileBackend.h>
+#include <text_buffer/MappedFile.h>
+#include <tracing/Latency.h>
+#include <tracing/Trace.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 #include <limits>
 #include <fstream>
 
-Editor::Editor()
+Editor::Editor() : Editor(std::make_unique<TerminalFrontend>()) {};
+
+Editor::Editor(std::unique_ptr<Frontend> editor_frontend) : frontend(std::move(editor_frontend))
 {
-    ncpp::init();
+    frontend->open();
 
     document_text = std::make_shared<TextBuffer>();
     cmd_bar_text = std::make_shared<TextBuffer>();
@@ -21,7 +28,6 @@ Editor::Editor()
     cmd_bar_win = std::make_shared<ncpp::Window>(1, ncpp::cols(), ncpp::rows() - 1, 0);
 
     title_bar->display_text("title bar");
-    document_win->display_text(document_text->get_text());
     cmd_bar_win->display_text("command bar");
 
     gutter->set_horizontal_expansion(false);
@@ -31,9 +37,14 @@ Editor::Editor()
     document_win->set_vertical_expansion(true);
     document_win->move_cursor(*document_cursor);
 
+    document_win->set_input_timeout(IDLE_TIMEOUT_MS);
+    cmd_bar_win->set_input_timeout(IDLE_TIMEOUT_MS);
+
     layout.add(title_bar, 0, 0).add(gutter, 1, 0).add(document_win, 1, 1).add(cmd_bar_win, 2, 0);
     layout.refresh();
 
+    display_document();
+
     document_ctx = Context(document_text, document_cursor, document_win);
     cmd_bar_ctx = Context(cmd_bar_text, cmd_bar_cursor, cmd_bar_win);
     current_ctx = document_ctx;
@@ -41,11 +52,394 @@ Editor::Editor()
     contexts.insert({Mode::EDITING, document_ctx});
     contexts.insert({Mode::GOTO, cmd_bar_ctx});
     contexts.insert({Mode::SAVING, cmd_bar_ctx});
+    contexts.insert({Mode::SEARCHING, cmd_bar_ctx});
+    contexts.insert({Mode::REPLACING, cmd_bar_ctx});
 }
 
 Editor::~Editor()
 {
-    ncpp::cleanup();
+    /* The windows have to go before the screen they belong to does. */
+    contexts.clear();
+    document_ctx = cmd_bar_ctx = current_ctx = Context();
+    layout = ncpp::Layout();
+
+    title_bar.reset();
+    gutter.reset();
+    document_win.reset();
+    cmd_bar_win.reset();
+
+    if (frontend != nullptr)
+        frontend->close();
+}
+
+bool Editor::open_file(const std::string &path)
+{
+    if (!document_text->open(path))
+    {
+        std::error_code error;
+        std::uintmax_t size = std::filesystem::file_size(path, error);
+
+        if (!error && size > MappedFile::MAX_SIZE)
+            status_message = "Can't open " + path + ": files over 2 GB aren't supported";
+        else
+            status_message = "Couldn't open " + path;
+
+        return false;
+    }
+
+    file_path = path;
+
+    document_cursor->row = 0;
+    document_cursor->col = 0;
+
+    display_document();
+    document_win->move_cursor(*document_cursor);
+
+    return true;
+}
+
+void Editor::set_save_sync(SyncPolicy sync)
+{
+    save_sync = sync;
+}
+
+void Editor::set_autosave_enabled(bool enabled)
+{
+    autosave_enabled = enabled;
+}
+
+void Editor::set_frame_rate_cap(int frames_per_second)
+{
+    if (frames_per_second <= 0)
+        frame_interval = std::chrono::steady_clock::duration::zero();
+    else
+        frame_interval = std::chrono::steady_clock::duration(std::chrono::seconds(1)) / frames_per_second;
+}
+
+bool Editor::is_saved()
+{
+    return saved_edit_count == edit_count;
+}
+
+void Editor::start_save(const std::string &path)
+{
+    save_worker.save(document_text->snapshot(), path, save_sync, edit_count);
+}
+
+std::string Editor::autosave_path()
+{
+    return file_path.empty() ? "mano-autosave.txt" : file_path + ".autosave";
+}
+
+void Editor::poll_saves()
+{
+    SaveStatus status = save_worker.status();
+
+    if (status.state == SaveState::SAVING)
+    {
+        std::size_t percent = status.bytes_total == 0 ? 100 : status.bytes_written * 100 / status.bytes_total;
+        status_message = "Saving " + status.file_path + " (" + std::to_string(percent) + "%)";
+    }
+    else if (status.finished_count != seen_save_count)
+    {
+        seen_save_count = status.finished_count;
+
+        bool autosave = status.file_path == autosave_path();
+
+        if (status.state == SaveState::FAILED)
+        {
+            status_message = "Couldn't save " + status.file_path;
+        }
+        else if (autosave)
+        {
+            status_message = "Autosaved to " + status.file_path;
+        }
+        else
+        {
+            /* Only what this save wrote is saved, not whatever a later (still running, or
+            replaced) save was started for. */
+            saved_edit_count = status.version;
+            status_message = "Saved " + status.file_path;
+
+            /* The recovery copy is out of date now, and would only be confusing. */
+            if (is_saved())
+                std::remove(autosave_path().c_str());
+        }
+    }
+
+    /* Autosaves go to a separate recovery file rather than over the user's file, and are skipped
+    while another save is running so they never delay (or replace) one the user asked for. */
+    auto now = std::chrono::steady_clock::now();
+
+    if (autosave_enabled && !is_saved() && edit_count != autosaved_edit_count && now - last_autosave >= AUTOSAVE_INTERVAL && !save_worker.busy())
+    {
+        autosaved_edit_count = edit_count;
+        last_autosave = now;
+
+        save_worker.save(document_text->snapshot(), autosave_path(), SyncPolicy::NONE, edit_count);
+    }
+
+    if (current_state == Mode::EDITING)
+        display_status();
+}
+
+bool Editor::poll_stats(bool input_idle)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    /* A gap buffer snapshot copies the whole text, which would stall typing in a large document,
+    so only piece tables are counted in the background (see display_status()). */
+    if (!document_text->has_cheap_snapshots())
+        return false;
+
+    /* Counting is throttled while input keeps coming, and catches up as soon as it stops. */
+    bool due = input_idle || now - last_stats_update >= STATS_INTERVAL;
+
+    if (edit_count != stats_edit_count && due && !stats_worker.busy())
+    {
+        stats_edit_count = edit_count;
+        last_stats_update = now;
+
+        stats_worker.update(document_text->snapshot(), edit_count);
+    }
+
+    TextStats stats = stats_worker.stats();
+
+    return stats.counted && stats.version != displayed_stats_version;
+}
+
+int Editor::stats_wait_ms()
+{
+    auto remaining = last_stats_update + STATS_INTERVAL - std::chrono::steady_clock::now();
+
+    return std::max(1, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count()));
+}
+
+void Editor::set_search_pattern(const std::string &typed)
+{
+    if (typed.size() >= 2 && typed.front() == '/' && typed.back() == '/')
+    {
+        search_mode = SearchMode::REGEX;
+        search_pattern = typed.substr(1, typed.size() - 2);
+    }
+    else
+    {
+        search_mode = SearchMode::LITERAL;
+        search_pattern = typed;
+    }
+}
+
+void Editor::start_search(std::size_t from)
+{
+    search_matches.clear();
+    search_edit_count = edit_count;
+
+    /* A gap buffer snapshot would copy the whole text here on the UI thread, whereas switching it
+    to a piece table copies nothing, and makes this and every later snapshot cheap. */
+    document_text->use_piece_table();
+
+    search_running = search.start(document_text->snapshot(), search_pattern, search_mode, from);
+    search_jump_pending = search_running;
+
+    if (!search_running)
+        status_message = "Invalid pattern " + search_pattern;
+}
+
+void Editor::find_next()
+{
+    if (search_pattern.empty())
+        return;
+
+    std::size_t from = cursor_offset() + 1;
+
+    /* Matches are only complete once the search has finished (without dropping any), and are only
+    current if nothing has been edited since it started. */
+    bool complete = !search_running && search_edit_count == edit_count && search_matches.size() == search.status().match_count;
+
+    if (!complete)
+    {
+        start_search(from);
+        return;
+    }
+
+    if (search_matches.empty())
+        return;
+
+    auto next = std::lower_bound(search_matches.begin(), search_matches.end(), from);
+    jump_to_offset(next == search_matches.end() ? search_matches.front() : *next);
+}
+
+bool Editor::poll_search()
+{
+    if (!search_running)
+        return false;
+
+    /* Edits move the text around, so the matches would point at the wrong places. */
+    if (edit_count != search_edit_count)
+    {
+        search.cancel();
+        search_matches.clear();
+        search_running = search_jump_pending = false;
+        status_message = "";
+
+        return false;
+    }
+
+    /* The status is read first, so that once it says the search is done, the matches taken after
+    it are all of them. */
+    SearchStatus status = search.status();
+    bool moved = false;
+
+    for (const SearchMatch &match : search.take_matches())
+        search_matches.push_back(match.offset);
+
+    if (search_jump_pending && (status.first_match || !status.searching))
+    {
+        search_jump_pending = false;
+
+        if (status.first_match && current_state == Mode::EDITING)
+        {
+            jump_to_offset(status.first_match->offset);
+            moved = true;
+        }
+    }
+
+    if (status.searching)
+    {
+        std::size_t percent = status.bytes_total == 0 ? 100 : status.bytes_scanned * 100 / status.bytes_total;
+        status_message = "Searching for " + search_pattern + " (" + std::to_string(status.match_count) + " found, " + std::to_string(percent) + "%)";
+    }
+    else
+    {
+        search_running = false;
+        std::sort(search_matches.begin(), search_matches.end());
+
+        /* Matches taken before later ones in the text pushed them past the cap are dropped, so
+        that the ones kept run from the start of the text without a gap. */
+        search_matches.erase(std::lower_bound(search_matches.begin(), search_matches.end(), status.kept_until), search_matches.end());
+
+        if (status.match_count == 0)
+            status_message = search_pattern + " not found";
+        else
+            status_message = std::to_string(status.match_count) + " matches for " + search_pattern;
+    }
+
+    if (current_state == Mode::EDITING)
+        display_status();
+
+    return moved;
+}
+
+void Editor::replace_all(const std::string &replacement)
+{
+    search_matches.clear();
+    search_running = search_jump_pending = false;
+
+    /* As in start_search(), so that the snapshot doesn't copy the text. */
+    document_text->use_piece_table();
+
+    if (!search.start(document_text->snapshot(), search_pattern, search_mode))
+    {
+        status_message = "Invalid pattern " + search_pattern;
+        return;
+    }
+
+    search.wait();
+
+    SearchStatus status = search.status();
+    std::vector<SearchMatch> matches = search.take_matches();
+
+    std::sort(matches.begin(), matches.end(), [](const SearchMatch &a, const SearchMatch &b)
+              { return a.offset < b.offset; });
+
+    /* Past the cap, only the matches up to status.kept_until are kept, so everything before that
+    point is replaced and nothing after it, rather than an arbitrary subset of the document. */
+    std::erase_if(matches, [&status](const SearchMatch &match)
+                  { return match.offset >= status.kept_until; });
+
+    /* Overlapping matches (e.g. "aa" twice in "aaa") can't both be replaced, so the first wins. */
+    std::vector<Replacement> replacements;
+    replacements.reserve(matches.size());
+
+    std::size_t replaced_up_to = 0;
+
+    for (const SearchMatch &match : matches)
+    {
+        if (match.offset < replaced_up_to)
+            continue;
+
+        replacements.push_back(Replacement{static_cast<int>(match.offset), static_cast<int>(match.length), replacement});
+        replaced_up_to = match.offset + match.length;
+    }
+
+    if (replacements.empty())
+    {
+        status_message = search_pattern + " not found";
+        return;
+    }
+
+    /* Only so many matches are kept per search, so the rest (all after the last one replaced) need
+    another go. Where that starts is found before replacing, while offsets still match lines. */
+    std::string left_message = "";
+
+    if (status.match_count > matches.size())
+    {
+        int last_line = document_text->get_line_of_offset(replacements.back().index) + 1;
+        left_message = " up to line " + std::to_string(last_line) + " (" + std::to_string(status.match_count - matches.size()) + " more left)";
+    }
+
+    document_text->replace(replacements);
+
+    document_cursor->row = document_text->get_cursor_row();
+    document_cursor->col = document_text->get_cursor_col();
+    prev_column = document_cursor->col;
+
+    edit_count++;
+
+    status_message = "Replaced " + std::to_string(replacements.size()) + " of " + search_pattern + left_message;
+}
+
+std::size_t Editor::cursor_offset()
+{
+    return document_text->get_line_start(document_cursor->row) + document_cursor->col;
+}
+
+void Editor::jump_to_offset(std::size_t offset)
+{
+    int line = document_text->get_line_of_offset(static_cast<int>(offset));
+
+    /* Jumping somewhere leaves just the one cursor, as do clicks and goto. */
+    document_text->clear_extra_cursors();
+    set_cursor_pos(Cursor{line, static_cast<int>(offset) - document_text->get_line_start(line)});
+    prev_column = current_ctx.cursor->col;
+}
+
+void Editor::display_status()
+{
+    std::string status = std::to_string(document_cursor->row + 1) + ":" + std::to_string(document_cursor->col + 1);
+
+    std::size_t extra_cursor_count = document_text->get_extra_cursors().size();
+
+    if (extra_cursor_count > 0)
+        status += " (" + std::to_string(extra_cursor_count + 1) + " cursors)";
+
+    if (!status_message.empty())
+        status += "  " + status_message;
+
+    TextStats stats = stats_worker.stats();
+
+    /* Without background counting, only what the buffer already knows is shown. */
+    if (!document_text->has_cheap_snapshots())
+        status += "  lines: " + std::to_string(document_text->get_line_count()) + "  bytes: " + std::to_string(document_text->get_text().size());
+    else if (stats.counted)
+    {
+        status += "  lines: " + std::to_string(stats.line_count) + "  words: " + std::to_string(stats.word_count) + "  bytes: " + std::to_string(stats.byte_count) + "  longest line: " + std::to_string(stats.longest_line);
+        displayed_stats_version = stats.version;
+    }
+    else
+        status += "  line count: computing...";
+
+    cmd_bar_win->display_text(status);
 }
 
 void Editor::set_cursor_pos(const Cursor &new_cursor)
@@ -54,6 +448,7 @@ void Editor::set_cursor_pos(const Cursor &new_cursor)
     int new_col = new_cursor.col;
 
     /* Enforce contstraints to ensure the cursor doesn't go beyond the line/document length. */
+    current_ctx.text->index_to_line(new_row);
     int max_row = std::max(0, current_ctx.text->get_line_count() - 1);
 
     if (new_row > max_row)
@@ -71,12 +466,27 @@ void Editor::set_cursor_pos(const Cursor &new_cursor)
     current_ctx.cursor->row = new_row;
     current_ctx.cursor->col = new_col;
 
+    current_ctx.text->set_cursor_pos(new_row, new_col);
     current_ctx.window->move_cursor(*current_ctx.cursor);
 }
 
+void Editor::sync_cursor()
+{
+    current_ctx.cursor->row = current_ctx.text->get_cursor_row();
+    current_ctx.cursor->col = current_ctx.text->get_cursor_col();
+    prev_column = current_ctx.cursor->col;
+}
+
+void Editor::count_edit()
+{
+    /* Typing into the command bar (e.g. a search pattern) isn't an edit to the document. */
+    if (current_ctx.text == document_text)
+        edit_count++;
+}
+
 void Editor::set_line_numbers(int start_num, int end_num)
 {
-    int final_num = std::min(end_num, gutter->get_height());
+    int final_num = std::min(end_num, start_num + gutter->get_height() - 1);
 
     /* Quick and easy way to find the maximum number of digits for the line numbers. */
     int max_digit_count = std::to_string(final_num).length();
@@ -100,6 +510,117 @@ void Editor::set_line_numbers(int start_num, int end_num)
     gutter->display_text(line_numbers);
 }
 
+void Editor::scroll_to_cursor()
+{
+    int height = document_win->get_height();
+    int width = document_win->get_width();
+
+    if (document_cursor->row < view_top)
+        view_top = document_cursor->row;
+    else if (document_cursor->row >= view_top + height)
+        view_top = document_cursor->row - height + 1;
+
+    if (document_cursor->col < view_left)
+        view_left = document_cursor->col;
+    else if (document_cursor->col >= view_left + width)
+        view_left = document_cursor->col - width + 1;
+
+    document_win->set_scroll(view_top, view_left);
+}
+
+void Editor::display_document()
+{
+    scroll_to_cursor();
+
+    int height = document_win->get_height();
+    int width = document_win->get_width();
+
+    /* Only the lines on screen (and one more, to know whether there are more) need indexing. */
+    document_text->index_to_line(view_top + height);
+    int line_count = document_text->get_line_count();
+
+    LineDamage damage = document_text->take_damage();
+
+    bool scrolled = view_top != rendered_top || view_left != rendered_left;
+    bool resized = height != rendered_height || width != rendered_width;
+
+    if (scrolled || resized)
+    {
+        damage.first_line = view_top;
+        damage.last_line = view_top + height - 1;
+    }
+
+    /* Only redraw the damaged lines that are actually on screen. */
+    int first_row = std::max(damage.first_line, view_top) - view_top;
+    int last_row = std::min(damage.last_line, view_top + height - 1) - view_top;
+
+    for (int win_row = first_row; win_row <= last_row; win_row++)
+    {
+        document_text->get_line(view_top + win_row, view_left, width).copy_to(row_scratch);
+        document_win->set_row(win_row, row_scratch);
+    }
+
+    display_extra_cursors();
+    document_win->reload();
+
+    if (scrolled || resized || line_count != rendered_line_count)
+        set_line_numbers(view_top + 1, line_count);
+
+    rendered_top = view_top;
+    rendered_left = view_left;
+    rendered_height = height;
+    rendered_width = width;
+    rendered_line_count = line_count;
+}
+
+void Editor::display_extra_cursors()
+{
+    const std::vector<int> &extra_cursors = document_text->get_extra_cursors();
+    std::vector<Cursor> marks;
+
+    if (!extra_cursors.empty())
+    {
+        int view_bottom = view_top + document_win->get_height();
+        int view_start = document_text->get_line_start(view_top);
+        int view_end = view_bottom < document_text->get_line_count() ? document_text->get_line_start(view_bottom) : std::numeric_limits<int>::max();
+
+        auto cursor = std::lower_bound(extra_cursors.begin(), extra_cursors.end(), view_start);
+
+        for (; cursor != extra_cursors.end() && *cursor < view_end; cursor++)
+        {
+            int line = document_text->get_line_of_offset(*cursor);
+            marks.push_back(Cursor{line, *cursor - document_text->get_line_start(line)});
+        }
+    }
+
+    document_win->set_marks(marks);
+}
+
+void Editor::render()
+{
+    TIME_STAGE(tracing::Stage::RENDER);
+
+    if (current_state == Mode::EDITING)
+    {
+        display_status();
+        display_document();
+    }
+    else
+    {
+        current_ctx.text->get_text().copy_to(row_scratch);
+        current_ctx.window->display_text(row_scratch);
+    }
+
+    present();
+}
+
+void Editor::present()
+{
+    current_ctx.window->move_cursor(*current_ctx.cursor);
+    current_ctx.window->reload();
+    ncpp::update();
+}
+
 void Editor::update_cursor(int key)
 {
     int current_row = current_ctx.cursor->row;
@@ -163,6 +684,8 @@ void Editor::change_state(Mode new_state)
     if (!contexts.contains(new_state))
         return;
 
+    TRACE(tracing::Level::INFO, "mode %d -> %d", static_cast<int>(current_state), static_cast<int>(new_state));
+
     current_state = new_state;
     current_ctx = contexts[new_state];
     current_ctx.window->move_cursor(*current_ctx.cursor);
@@ -170,136 +693,382 @@ void Editor::change_state(Mode new_state)
 
 void Editor::start_state_machine()
 {
+    bool input_idle = false;
+
     while (true)
     {
+        poll_saves();
+
+        bool indexed = document_text->poll_line_index();
+        bool counted = poll_stats(input_idle);
+
+        if (poll_search() || indexed || counted)
+            render();
+
+        present();
+
+        bool background_work = search_running || !document_text->is_line_index_complete() || stats_worker.busy();
+
+        /* A stats update that hasn't started yet isn't background work. Input is only waited for
+        until it's due, and if none comes by then, the update goes ahead (see poll_stats()). */
+        bool stats_pending = document_text->has_cheap_snapshots() && edit_count != stats_edit_count;
+
         /* Conceptually a character, but int is used (ncurses does this, so we do too). */
-        int input = current_ctx.window->get_input();
-        MEVENT mouse_event;
+        int input;
+
+        if (background_work)
+            input = frontend->poll_input(*current_ctx.window, BACKGROUND_POLL_MS);
+        else if (stats_pending)
+            input = frontend->poll_input(*current_ctx.window, stats_wait_ms());
+        else
+            input = frontend->get_input(*current_ctx.window);
+
+        if (input == Frontend::END_OF_INPUT)
+            return;
 
-        switch (input)
+        input_idle = input == ERR;
+
+        if (input == ERR)
         {
-        case ERR:
+            /* No input within the idle timeout, so give back any memory left over from large edits. */
+            if (!background_work)
+                document_ctx.text->compact();
+
             continue;
-        case KEY_RESIZE:
-            layout.refresh();
+        }
+
+        /* Apply everything that has queued up (key repeat, fast typing, input that arrived while the
+        last frame was being drawn) before drawing once, so that the cost of a burst of keys is the
+        cost of the edits plus a single redraw, not a redraw per key. */
+        auto deadline = frame_interval.count() > 0 ? last_frame + frame_interval : std::chrono::steady_clock::now() + MAX_BATCH_DURATION;
+
+        while (input != ERR)
+        {
+            if (!handle_input(input))
+                return;
+
+            auto now = std::chrono::steady_clock::now();
+
+            if (now >= deadline)
+                break;
+
+            /* With a frame rate cap, keep taking input until the next frame is due. Without one, only
+            take what's already pending. */
+            int wait_ms = 0;
+
+            if (frame_interval.count() > 0)
+                wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+
+            input = frontend->poll_input(*current_ctx.window, wait_ms);
+        }
+
+        render();
+        last_frame = std::chrono::steady_clock::now();
+    }
+}
+
+bool Editor::handle_input(int input)
+{
+    MEVENT mouse_event;
+
+    switch (input)
+    {
+    case Frontend::END_OF_INPUT:
+        return false;
+    case KEY_RESIZE:
+        layout.refresh();
+        break;
+    case KEY_MOUSE:
+        if (getmouse(&mouse_event) != OK)
             break;
-        case KEY_MOUSE:
-            if (getmouse(&mouse_event) != OK)
-                continue;
 
-            if (mouse_event.bstate & BUTTON1_CLICKED)
-            {
-                Cursor new_pos;
-                new_pos.row = mouse_event.y;
-                new_pos.col = mouse_event.x;
-                set_cursor_pos(new_pos);
-                continue;
-            }
+        /* Rows are lines (they're clipped, not wrapped), so a click maps straight onto a line and
+        column, once the window's position and scroll are taken off. */
+        if ((mouse_event.bstate & BUTTON1_CLICKED) && current_state == Mode::EDITING && document_win->contains(mouse_event.y, mouse_event.x))
+        {
+            Cursor new_pos;
+            new_pos.row = view_top + mouse_event.y - document_win->get_row();
+            new_pos.col = view_left + mouse_event.x - document_win->get_col();
+
+            document_text->clear_extra_cursors();
+            set_cursor_pos(new_pos);
+            prev_column = current_ctx.cursor->col;
+        }
 
+        break;
+    case KEY_BACKSPACE:
+    case 127:
+    case '\b':
+        /* Only update line numbers if the line count has changed. */
+        // if (current_cursor->col == 0)
+        //     set_line_numbers(1, current_text->get_line_count());
+
+        current_ctx.text->pop();
+        sync_cursor();
+        count_edit();
+        break;
+    case ncpp::PASTE:
+    {
+        std::string pasted = frontend->take_paste(*current_ctx.window);
+
+        /* The command bar is a single line, so only take the first line of the paste. */
+        if (current_state != Mode::EDITING)
+            pasted = pasted.substr(0, pasted.find('\n'));
+
+        /* The whole paste is applied as a single edit. */
+        current_ctx.text->insert(std::string_view(pasted));
+
+        sync_cursor();
+        count_edit();
+        break;
+    }
+    case KEY_DOWN:
+    case KEY_UP:
+    case KEY_LEFT:
+    case KEY_RIGHT:
+        if (current_state == Mode::EDITING)
+            document_text->clear_extra_cursors();
+
+        update_cursor(input);
+        break;
+    case ncpp::CTRL_C:
+    case ncpp::CTRL_X:
+    case ncpp::CTRL_Q:
+        /* A save that's still running may be about to make the document saved. */
+        save_worker.wait();
+        poll_saves();
+
+        if (is_saved() || current_state == Mode::SAVING)
+            return false;
+
+        quit_after_save = true;
+        change_state(Mode::SAVING);
+        current_ctx.window->set_preamble("Save project: ");
+        break;
+    case ncpp::CTRL_S:
+        if (current_state != Mode::EDITING)
             break;
-        case KEY_BACKSPACE:
-        case 127:
-        case '\b':
-            /* Only update line numbers if the line count has changed. */
-            // if (current_cursor->col == 0)
-            //     set_line_numbers(1, current_text->get_line_count());
-
-            update_cursor(KEY_LEFT);
-            current_ctx.text->pop();
-            set_line_numbers(1, current_ctx.text->get_line_count());
-
-            current_ctx.window->display_text(current_ctx.text->get_text());
-            current_ctx.text->set_cursor_pos(current_ctx.cursor->row, current_ctx.cursor->col);
-            saved = false;
+
+        if (file_path.empty())
+        {
+            quit_after_save = false;
+            change_state(Mode::SAVING);
+            current_ctx.window->set_preamble("Save as: ");
             break;
-        case KEY_DOWN:
-        case KEY_UP:
-        case KEY_LEFT:
-        case KEY_RIGHT:
-            update_cursor(input);
-            current_ctx.text->set_cursor_pos(current_ctx.cursor->row, current_ctx.cursor->col);
+        }
+
+        start_save(file_path);
+        break;
+    case ncpp::CTRL_T:
+    {
+        std::ofstream trace_file(trace_file_path, std::ofstream::out | std::ofstream::trunc);
+
+        trace_file << "= Trace =" << std::endl;
+        tracing::dump(trace_file);
+
+        trace_file << "\n= Latency =" << std::endl;
+        tracing::dump_latency(trace_file);
+
+        trace_file << "\n= Document =" << std::endl;
+        document_ctx.text->dump(trace_file);
+
+        break;
+    }
+    case ncpp::CTRL_L:
+        status_message = tracing::latency_summary();
+        break;
+    case ncpp::CTRL_Z:
+    case ncpp::CTRL_Y:
+        if (!(input == ncpp::CTRL_Z ? current_ctx.text->undo() : current_ctx.text->redo()))
             break;
-        case ncpp::CTRL_C:
-        case ncpp::CTRL_X:
-        case ncpp::CTRL_Q:
-            if (saved || current_state == Mode::SAVING)
-                return;
 
-            change_state(Mode::SAVING);
-            current_ctx.window->set_preamble("Save project: ");
+        sync_cursor();
+        count_edit();
+        break;
+    case ncpp::CTRL_F:
+        if (current_state == Mode::SEARCHING)
+        {
+            current_ctx.text->clear();
+            current_ctx.window->set_preamble("");
+            change_state(Mode::EDITING);
+        }
+        else if (current_state == Mode::EDITING)
+        {
+            change_state(Mode::SEARCHING);
+            current_ctx.window->set_preamble("Find: ");
+            set_cursor_pos(Cursor{0, 0});
+        }
+        break;
+    case ncpp::CTRL_N:
+        if (current_state == Mode::EDITING)
+            find_next();
+        break;
+    case ncpp::CTRL_D:
+        /* Leaves a cursor behind and moves down a line, so that holding it down makes a column of
+        cursors to type into. */
+        if (current_state != Mode::EDITING)
             break;
-        case ncpp::CTRL_S:
-            saved = true;
+
+    {
+        Cursor left_behind = *document_cursor;
+
+        update_cursor(KEY_DOWN);
+        document_text->add_cursor(left_behind.row, left_behind.col);
+        break;
+    }
+    case ncpp::ESCAPE:
+        if (current_state == Mode::EDITING)
+            document_text->clear_extra_cursors();
+        break;
+    case ncpp::CTRL_R:
+        if (current_state == Mode::REPLACING)
+        {
+            current_ctx.text->clear();
+            current_ctx.window->set_preamble("");
+            change_state(Mode::EDITING);
+        }
+        else if (current_state == Mode::EDITING)
+        {
+            replace_pattern_entered = false;
+            change_state(Mode::REPLACING);
+            current_ctx.window->set_preamble("Replace: ");
+            set_cursor_pos(Cursor{0, 0});
+        }
+        break;
+    case ncpp::CTRL_G:
+        if (current_state == Mode::GOTO)
+        {
+            current_ctx.text->clear();
+            change_state(Mode::EDITING);
+        }
+        else if (current_state == Mode::EDITING)
+        {
+            change_state(Mode::GOTO);
+            set_cursor_pos(Cursor{0, 0});
+        }
+        break;
+    case '\n':
+        if (current_state == Mode::GOTO)
+        {
+            auto [row_opt, col_opt] = parse_goto_command(current_ctx.text->get_text().to_string());
+
+            Cursor new_cursor;
+            new_cursor.row = row_opt ? *row_opt : document_cursor->row;
+            new_cursor.col = col_opt ? *col_opt : document_cursor->col;
+
+            current_ctx.text->clear();
+            change_state(Mode::EDITING);
+
+            document_text->clear_extra_cursors();
+            set_cursor_pos(new_cursor);
+
             break;
-        case ncpp::CTRL_G:
-            if (current_state == Mode::GOTO)
-            {
-                current_ctx.text->clear();
-                change_state(Mode::EDITING);
-            }
-            else if (current_state == Mode::EDITING)
+        }
+        else if (current_state == Mode::SEARCHING)
+        {
+            std::string pattern = current_ctx.text->get_text().to_string();
+
+            current_ctx.text->clear();
+            current_ctx.window->set_preamble("");
+            change_state(Mode::EDITING);
+
+            /* An empty search repeats the last one. */
+            if (pattern.empty())
             {
-                change_state(Mode::GOTO);
-                set_cursor_pos(Cursor{0, 0});
+                find_next();
+                break;
             }
+
+            set_search_pattern(pattern);
+            start_search(cursor_offset());
             break;
-        case '\n':
-            if (current_state == Mode::GOTO)
-            {
-                auto [row_opt, col_opt] = parse_goto_command(current_ctx.text->get_text());
+        }
+        else if (current_state == Mode::REPLACING)
+        {
+            std::string typed = current_ctx.text->get_text().to_string();
+            current_ctx.text->clear();
 
-                Cursor new_cursor;
-                new_cursor.row = row_opt ? *row_opt : current_ctx.cursor->row;
-                new_cursor.col = col_opt ? *col_opt : current_ctx.cursor->col;
+            if (!replace_pattern_entered)
+            {
+                if (typed.empty())
+                    break;
 
-                current_ctx.text->clear();
-                change_state(Mode::EDITING);
-                set_cursor_pos(new_cursor);
+                set_search_pattern(typed);
+                replace_pattern_entered = true;
 
+                current_ctx.window->set_preamble("Replace " + typed + " with: ");
+                set_cursor_pos(Cursor{0, 0});
                 break;
             }
-            else if (current_state == Mode::SAVING)
-            {
-                if (current_ctx.text->is_empty())
-                    break;
 
-                file_path = current_ctx.text->get_text();
+            current_ctx.window->set_preamble("");
+            change_state(Mode::EDITING);
 
-                backend->save(file_path, document_ctx.text->get_text());
+            replace_all(typed);
+            break;
+        }
+        else if (current_state == Mode::SAVING)
+        {
+            if (current_ctx.text->is_empty())
+                break;
 
-                saved = true;
-                return;
-            }
+            file_path = current_ctx.text->get_text().to_string();
+            start_save(file_path);
 
-            current_ctx.text->insert(static_cast<char>(input));
+            if (quit_after_save)
+            {
+                save_worker.wait();
+                poll_saves();
 
-            if (current_state == Mode::EDITING)
-                set_line_numbers(1, current_ctx.text->get_line_count());
+                if (is_saved())
+                    return false;
 
-            update_cursor(KEY_DOWN);
-            current_ctx.cursor->col = 0;
+                current_ctx.window->set_preamble("Couldn't save, try again: ");
+                break;
+            }
+
+            current_ctx.text->clear();
+            current_ctx.window->set_preamble("");
+            change_state(Mode::EDITING);
 
-            current_ctx.window->display_text(current_ctx.text->get_text());
-            saved = false;
-            break;
-        default:
-            current_ctx.text->insert(static_cast<char>(input));
-            update_cursor(KEY_RIGHT);
-            current_ctx.window->display_text(current_ctx.text->get_text());
-            saved = false;
             break;
-        };
+        }
 
-        if (current_state == Mode::EDITING)
-            cmd_bar_win->display_text(std::to_string(current_ctx.cursor->row + 1) + ":" + std::to_string(current_ctx.cursor->col + 1));
+        current_ctx.text->insert(static_cast<char>(input));
+        sync_cursor();
+        count_edit();
+        break;
+    default:
+        current_ctx.text->insert(static_cast<char>(input));
+        sync_cursor();
+        count_edit();
+        break;
+    };
 
-        current_ctx.window->display_text(current_ctx.text->get_text());
-        current_ctx.window->move_cursor(*current_ctx.cursor);
-    }
+    return true;
 }
 
 std::pair<std::optional<int>, std::optional<int>> Editor::parse_goto_command(std::string command)
 {
+    /* "@offset" goes to a byte offset (e.g. from a compiler error or a hex dump), rather than a line
+    and column. */
+    if (command.starts_with('@'))
+    {
+        try
+        {
+            int offset = std::clamp(std::stoi(command.substr(1)), 0, document_text->get_text().size());
+            int line = document_text->get_line_of_offset(offset);
+
+            return std::make_pair(line, offset - document_text->get_line_start(line));
+        }
+        catch (const std::logic_error &)
+        {
+            /* Either not a number or too big for one (stoi() throws invalid_argument or out_of_range,
+            which are both logic_errors). */
+            return std::make_pair(std::nullopt, std::nullopt);
+        }
+    }
+
     std::string::size_type delim_pos = command.find(':');
 
     std::optional<int> row;
@@ -308,7 +1077,7 @@ std::pair<std::optional<int>, std::optional<int>> Editor::parse_goto_command(std
     {
         row = std::stoi(command.substr(0, delim_pos)) - 1;
     }
-    catch (std::invalid_argument)
+    catch (const std::logic_error &)
     {
         row = std::nullopt;
     }
@@ -322,7 +1091,7 @@ std::pair<std::optional<int>, std::optional<int>> Editor::parse_goto_command(std
     {
         col = std::stoi(command.substr(delim_pos + 1, command.length())) - 1;
     }
-    catch (std::invalid_argument)
+    catch (const std::logic_error &)
     {
         col = std::nullopt;
     }
@@ -3,18 +3,26 @@
 #include <ncpp/ncpp.h>
 #include <ncpp/Window.h>
 #include <ncpp/Layout.h>
+#include "Frontend.h"
+
+#include <text_buffer/SaveWorker.h>
+#include <text_buffer/StatsWorker.h>
 #include <text_buffer/TextBuffer.h>
-#include <io_backend/IOBackend.h>
+#include <text_buffer/TextSearch.h>
 
+#include <chrono>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 #include <memory>
 
 enum class Mode
 {
     EDITING,
     GOTO,
-    SAVING
+    SAVING,
+    SEARCHING,
+    REPLACING
 };
 
 class Context
@@ -33,14 +41,30 @@ public:
 class Editor
 {
 public:
+    /* Runs in the terminal. */
     Editor();
-    Editor(IOBackend *io_backend) : backend(io_backend) {};
+
+    explicit Editor(std::unique_ptr<Frontend> editor_frontend);
     ~Editor();
 
+    /* Loads the file at path into the document. Returns false if it couldn't be opened. */
+    bool open_file(const std::string &path);
+
     void start_state_machine();
 
+    /* Sets how thoroughly saves are flushed to disk (see SyncPolicy). */
+    void set_save_sync(SyncPolicy sync);
+
+    /* Autosaving is on by default, but e.g. replays shouldn't leave recovery files behind. */
+    void set_autosave_enabled(bool enabled);
+
+    /* Draws at most this many frames a second, applying all the input that arrives in between at
+    once. Zero (the default) draws as soon as the pending input has been applied. */
+    void set_frame_rate_cap(int frames_per_second);
+
 private:
-    IOBackend *backend;
+    std::unique_ptr<Frontend> frontend;
+    SyncPolicy save_sync = SyncPolicy::FILE;
     Mode current_state = Mode::EDITING;
 
     std::shared_ptr<TextBuffer> document_text;
@@ -51,6 +75,21 @@ private:
 
     int prev_column = 0;
 
+    /* The document line and column shown at the top left of the document window. */
+    int view_top = 0;
+    int view_left = 0;
+
+    /* The viewport as of the last display_document(). If it has changed since, every visible line
+    needs redrawing, not just the ones damaged by edits. */
+    int rendered_top = -1;
+    int rendered_left = -1;
+    int rendered_height = -1;
+    int rendered_width = -1;
+    int rendered_line_count = -1;
+
+    /* Reused to copy text views into, so that redrawing doesn't allocate once it has warmed up. */
+    std::string row_scratch;
+
     std::shared_ptr<ncpp::Window> title_bar;
     std::shared_ptr<ncpp::Window> gutter;
     std::shared_ptr<ncpp::Window> document_win;
@@ -66,13 +105,136 @@ private:
 
     char command_delim = ':';
 
-    bool saved = true;
+    /* Where Ctrl+T dumps the trace buffer and document state to. */
+    const std::string trace_file_path = "mano-trace.txt";
+
+    /* How long without input before the editor considers itself idle. */
+    static constexpr int IDLE_TIMEOUT_MS = 1000;
+
     std::string file_path = "";
 
+    /* Input is applied in batches, with one frame drawn per batch. frame_interval is the minimum
+    time between frames (zero for no cap), and MAX_BATCH_DURATION stops a constant stream of input
+    (e.g. a huge paste typed out by the terminal) from holding off drawing indefinitely. */
+    static constexpr std::chrono::milliseconds MAX_BATCH_DURATION = std::chrono::milliseconds(50);
+    std::chrono::steady_clock::duration frame_interval = std::chrono::steady_clock::duration::zero();
+    std::chrono::steady_clock::time_point last_frame;
+
+    /* Counts edits, so that saves can tell whether the document has changed since they started. */
+    int edit_count = 0;
+    int saved_edit_count = 0;
+
+    /* Saves run in the background, and are polled for progress once per loop. */
+    SaveWorker save_worker;
+    int seen_save_count = 0;
+    bool quit_after_save = false;
+    std::string status_message = "";
+
+    /* How often unsaved changes are written to the recovery file. */
+    static constexpr std::chrono::seconds AUTOSAVE_INTERVAL = std::chrono::seconds(30);
+    std::chrono::steady_clock::time_point last_autosave = std::chrono::steady_clock::now();
+    int autosaved_edit_count = 0;
+    bool autosave_enabled = true;
+
+    /* Document statistics are counted in the background from snapshots, at most this often while
+    editing, and read back lock free for the command bar. */
+    static constexpr std::chrono::milliseconds STATS_INTERVAL = std::chrono::milliseconds(200);
+    StatsWorker stats_worker;
+    std::chrono::steady_clock::time_point last_stats_update;
+    int stats_edit_count = -1;
+    int displayed_stats_version = -1;
+
+    /* Searches run in the background, from the cursor, and the cursor jumps to the first match as
+    soon as it's known (see TextSearch::status()). The rest of the matches stream in afterwards, so
+    that later find_next()s don't have to search again. */
+    TextSearch search;
+    std::string search_pattern = "";
+    SearchMode search_mode = SearchMode::LITERAL;
+    bool search_running = false;
+    bool search_jump_pending = false;
+    int search_edit_count = 0;
+    std::vector<std::size_t> search_matches;
+
+    /* While a search, line indexing or counting is running, input is only waited for this long at a
+    time, so that their results show up as they arrive rather than with the next key. */
+    static constexpr int BACKGROUND_POLL_MS = 10;
+
+    /* Replacing prompts twice, first for the pattern (which becomes the search pattern) and then for
+    what to replace it with. */
+    bool replace_pattern_entered = false;
+
+    bool is_saved();
+    void start_save(const std::string &path);
+    std::string autosave_path();
+
+    /* Picks up finished saves (marking the document as saved), updates the progress shown in the
+    command bar, and starts an autosave if one is due. */
+    void poll_saves();
+
+    /* Queues the document to have its statistics counted if it has changed since they last were
+    (and they're due, which they always are once input_idle says input has stopped), and returns
+    whether newer statistics have been published since they were last shown. */
+    bool poll_stats(bool input_idle);
+
+    /* How long input can be waited for before the next stats update is due. */
+    int stats_wait_ms();
+
+    /* Sets search_pattern from what was typed, where "/pattern/" is a regex and anything else is
+    searched for literally. */
+    void set_search_pattern(const std::string &typed);
+
+    /* Starts searching for search_pattern from the text space offset. */
+    void start_search(std::size_t from);
+
+    /* Moves to the next match after the cursor, using the matches already found if they're complete
+    and still current, and searching again otherwise. */
+    void find_next();
+
+    /* Collects streamed matches, jumps to the first one if that's pending, and updates the progress
+    shown in the command bar. Returns whether anything needs redrawing. */
+    bool poll_search();
+
+    /* Replaces every match of search_pattern with replacement. The whole document is searched
+    first, then all the matches are replaced as a single edit (see TextBuffer::replace()). */
+    void replace_all(const std::string &replacement);
+
+    std::size_t cursor_offset();
+    void jump_to_offset(std::size_t offset);
+
+    /* Shows the cursor position, the document statistics and the latest save status in the command
+    bar. */
+    void display_status();
+
+    /* Applies a single input. Returns false if it ends the editor (e.g. quitting). */
+    bool handle_input(int input);
+
     void set_cursor_pos(const Cursor &new_cursor);
+
+    /* Moves the on-screen cursor to where the text's cursor is, e.g. after an edit moved it. */
+    void sync_cursor();
+
+    /* Counts an edit just made through current_ctx, if it was to the document. */
+    void count_edit();
     void change_state(Mode new_state);
 
     void set_line_numbers(int start_num, int end_num);
+
+    /* Scrolls the document window just enough to keep the cursor on screen. */
+    void scroll_to_cursor();
+
+    /* Redraws the document lines inside the viewport that were damaged by edits (or all of them, if
+    the viewport moved), so costs at most O(screen) rather than O(file). */
+    void display_document();
+
+    /* Highlights the extra cursors inside the viewport. Costs O(log n) per visible cursor, however
+    many cursors there are off screen. */
+    void display_extra_cursors();
+
+    /* Redraws whatever the last batch of input changed, then presents it. */
+    void render();
+
+    /* Sends all pending window changes to the terminal, leaving the cursor in the current window. */
+    void present();
     void update_cursor(int key);
     int get_line_end_offset(int line_num);
 
@@ -0,0 +1,55 @@
+#include "Frontend.h"
+#include "ReplayFrontend.h"
+
+TerminalFrontend::TerminalFrontend(const std::string &record_path)
+{
+    if (!record_path.empty())
+        recording.open(record_path, std::ofstream::out | std::ofstream::trunc);
+}
+
+void TerminalFrontend::open()
+{
+    ncpp::init();
+}
+
+void TerminalFrontend::close()
+{
+    ncpp::cleanup();
+}
+
+int TerminalFrontend::get_input(ncpp::Window &window)
+{
+    return record(window.get_input());
+}
+
+int TerminalFrontend::poll_input(ncpp::Window &window, int milliseconds)
+{
+    return record(window.poll_input(milliseconds));
+}
+
+int TerminalFrontend::record(int input)
+{
+    /* Timeouts and resizes depend on the moment, not the session, so aren't worth replaying. Pastes
+    are recorded by take_paste(), once their text is known. */
+    if (recording.is_open() && input != ERR && input != KEY_RESIZE && input != KEY_MOUSE && input != ncpp::PASTE)
+    {
+        /* Flushed every time, so that a session that ends in a crash can still be replayed. */
+        ReplayFrontend::record(recording, input);
+        recording.flush();
+    }
+
+    return input;
+}
+
+std::string TerminalFrontend::take_paste(ncpp::Window &window)
+{
+    std::string pasted = window.take_paste();
+
+    if (recording.is_open())
+    {
+        ReplayFrontend::record(recording, ncpp::PASTE, pasted);
+        recording.flush();
+    }
+
+    return pasted;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <ncpp/ncpp.h>
+#include <ncpp/Window.h>
+
+#include <fstream>
+#include <string>
+
+/* Where the editor's input comes from and where its output goes, so that the editor can be driven
+by something other than a terminal (e.g. replaying a recorded session, see ReplayFrontend). */
+class Frontend
+{
+public:
+    /* Returned by get_input() once there is no more input, which ends the editor's loop. */
+    static constexpr int END_OF_INPUT = KEY_MAX + 2;
+
+    virtual ~Frontend() = default;
+
+    /* Sets up ncurses to draw to wherever this frontend's output goes. Called before any windows
+    are created, and close() after they have all been destroyed. */
+    virtual void open() = 0;
+    virtual void close() = 0;
+
+    /* Returns the next input, in the same way as Window::get_input(). window is the focused one. */
+    virtual int get_input(ncpp::Window &window) = 0;
+
+    /* Returns the next input if there is one within milliseconds (zero for only what's already
+    pending), otherwise ERR. Lets the editor apply every queued input before drawing once. */
+    virtual int poll_input(ncpp::Window &window, int milliseconds) = 0;
+
+    /* Returns the pasted text, after get_input() returned ncpp::PASTE. */
+    virtual std::string take_paste(ncpp::Window &window) = 0;
+};
+
+/* Reads from and draws to the real terminal. */
+class TerminalFrontend : public Frontend
+{
+public:
+    /* If record_path isn't empty, every input is also written to it as a trace that ReplayFrontend
+    can replay. */
+    explicit TerminalFrontend(const std::string &record_path = "");
+
+    void open() override;
+    void close() override;
+
+    int get_input(ncpp::Window &window) override;
+    int poll_input(ncpp::Window &window, int milliseconds) override;
+    std::string take_paste(ncpp::Window &window) override;
+
+private:
+    std::ofstream recording;
+
+    /* Writes input to the recording (if there is one), then returns it. */
+    int record(int input);
+};
@@ -0,0 +1,156 @@
+#include "ReplayFrontend.h"
+
+#include <tracing/Latency.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+ReplayFrontend::ReplayFrontend(int rows, int cols) : rows(rows), cols(cols) {};
+
+bool ReplayFrontend::load(std::istream &trace)
+{
+    std::string line;
+
+    while (std::getline(trace, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (line.rfind("type ", 0) == 0)
+        {
+            for (char c : line.substr(5))
+                add_key(static_cast<unsigned char>(c));
+        }
+        else if (line.rfind("paste ", 0) == 0)
+        {
+            std::string text;
+
+            for (std::size_t i = 6; i < line.size(); i++)
+            {
+                if (line[i] != '\\' || i + 1 == line.size())
+                {
+                    text += line[i];
+                    continue;
+                }
+
+                char escaped = line[++i];
+
+                if (escaped == 'n')
+                    text += '\n';
+                else if (escaped == 't')
+                    text += '\t';
+                else
+                    text += escaped;
+            }
+
+            add_paste(text);
+        }
+        else
+        {
+            char *end = nullptr;
+            long key = std::strtol(line.c_str(), &end, 10);
+
+            if (end == line.c_str() || *end != '\0')
+                return false;
+
+            add_key(static_cast<int>(key));
+        }
+    }
+
+    return !trace.bad();
+}
+
+void ReplayFrontend::add_key(int key)
+{
+    inputs.push_back(Input{key, ""});
+}
+
+void ReplayFrontend::add_paste(const std::string &text)
+{
+    inputs.push_back(Input{ncpp::PASTE, text});
+}
+
+int ReplayFrontend::input_count() const
+{
+    return static_cast<int>(inputs.size());
+}
+
+void ReplayFrontend::set_burst(int inputs)
+{
+    burst = std::max(inputs, 1);
+}
+
+void ReplayFrontend::open()
+{
+    ncpp::init_headless(rows, cols);
+}
+
+void ReplayFrontend::close()
+{
+    ncpp::cleanup();
+}
+
+int ReplayFrontend::get_input(ncpp::Window &)
+{
+    if (next_input == inputs.size())
+        return END_OF_INPUT;
+
+    burst_remaining = burst - 1;
+    return next();
+}
+
+int ReplayFrontend::poll_input(ncpp::Window &, int)
+{
+    /* Never waits, as the rest of the trace is already here. Running out ends the burst, and the
+    next get_input() reports the end. */
+    if (burst_remaining == 0 || next_input == inputs.size())
+        return ERR;
+
+    burst_remaining--;
+    return next();
+}
+
+int ReplayFrontend::next()
+{
+    Input &input = inputs[next_input++];
+
+    /* Same as a key arriving at Window::get_input(), so that per-key latency is measured the same
+    way in both. */
+    tracing::begin_frame();
+
+    if (input.key == ncpp::PASTE)
+        paste_text = std::move(input.paste);
+
+    return input.key;
+}
+
+std::string ReplayFrontend::take_paste(ncpp::Window &)
+{
+    return std::exchange(paste_text, "");
+}
+
+void ReplayFrontend::record(std::ostream &os, int key, const std::string &paste)
+{
+    if (key != ncpp::PASTE)
+    {
+        os << key << '\n';
+        return;
+    }
+
+    os << "paste ";
+
+    for (char c : paste)
+    {
+        if (c == '\n')
+            os << "\\n";
+        else if (c == '\t')
+            os << "\\t";
+        else if (c == '\\')
+            os << "\\\\";
+        else
+            os << c;
+    }
+
+    os << '\n';
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Frontend.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Replays a keystroke trace against a headless screen (see ncpp::init_headless()), as fast as the
+editor can take it. Once the trace runs out, get_input() returns END_OF_INPUT.
+
+Traces are text, with one input per line:
+
+    <key code>          a key, as returned by Window::get_input() (e.g. 97 for 'a', 259 for up)
+    type <text>         each character of text, typed in turn
+    paste <text>        a single paste of text, with \n, \t, and \\ escapes
+    # <anything>        a comment
+
+TerminalFrontend writes this format when recording, using record(). */
+class ReplayFrontend : public Frontend
+{
+public:
+    ReplayFrontend(int rows, int cols);
+
+    /* Appends the inputs in the trace. Returns false if it can't be read or has an invalid line. */
+    bool load(std::istream &trace);
+
+    void add_key(int key);
+    void add_paste(const std::string &text);
+
+    /* Counts a paste as a single input. */
+    int input_count() const;
+
+    /* How many inputs are pending at once, i.e. how many poll_input() hands out after each
+    get_input(). The default of one is someone typing slower than the editor draws, larger values
+    are key repeat or typing into a busy editor, where inputs queue up between frames. */
+    void set_burst(int inputs);
+
+    void open() override;
+    void close() override;
+
+    int get_input(ncpp::Window &window) override;
+    int poll_input(ncpp::Window &window, int milliseconds) override;
+    std::string take_paste(ncpp::Window &window) override;
+
+    /* Writes a single input as a trace line. */
+    static void record(std::ostream &os, int key, const std::string &paste = "");
+
+private:
+    struct Input
+    {
+        int key;
+        std::string paste;
+    };
+
+    int rows;
+    int cols;
+
+    std::vector<Input> inputs;
+    std::size_t next_input = 0;
+    std::string paste_text = "";
+
+    int burst = 1;
+    int burst_remaining = 0;
+
+    int next();
+};
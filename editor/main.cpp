@@ -6,13 +6,36 @@
 
 #include "Editor.h"
 
-#include <io_backend/FileBackend.h>
+#include <tracing/Trace.h>
 
 int main(int argc, char *argv[])
 {
-    IOBackend *backend = new FileBackend();
-    // Editor editor = Editor(backend);
-    Editor editor = Editor();
+    tracing::set_level_from_env();
+    tracing::install_crash_handler("mano-crash.txt");
+
+    /* MANO_RECORD=<path> records the session as a trace that mano_replay can play back. */
+    const char *record_path = std::getenv("MANO_RECORD");
+    Editor editor = Editor(std::make_unique<TerminalFrontend>(record_path != nullptr ? record_path : ""));
+
+    /* Saves are fsync()ed by default. MANO_SAVE_SYNC=none skips that, and =full also syncs the
+    directory. */
+    if (const char *sync = std::getenv("MANO_SAVE_SYNC"))
+    {
+        std::string sync_name = sync;
+
+        if (sync_name == "none")
+            editor.set_save_sync(SyncPolicy::NONE);
+        else if (sync_name == "full")
+            editor.set_save_sync(SyncPolicy::FILE_AND_DIRECTORY);
+    }
+
+    /* MANO_MAX_FPS=<n> caps how often the screen is redrawn, e.g. for slow remote terminals. */
+    if (const char *max_fps = std::getenv("MANO_MAX_FPS"))
+        editor.set_frame_rate_cap(std::atoi(max_fps));
+
+    if (argc > 1)
+        editor.open_file(argv[1]);
+
     editor.start_state_machine();
 
     // while true
@@ -0,0 +1,170 @@
+#include "Editor.h"
+#include "ReplayFrontend.h"
+
+#include <tracing/Latency.h>
+#include <tracing/Trace.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+/* Replays a keystroke trace against the editor without a terminal, as fast as it will go, and
+reports the throughput and per-key latency. Without a trace, a synthetic editing session is
+generated instead.
+
+    mano_replay [--trace=<file>] [--generate=<inputs>] [--burst=<inputs>] [--rows=<n>] [--cols=<n>]
+                [--json] [document]
+
+--burst makes that many inputs pending at a time (see ReplayFrontend::set_burst()), to measure
+key repeat and typing that outpaces drawing.
+
+Traces can be recorded from a real session by running mano with MANO_RECORD=<file>. */
+
+/* Mostly typing words, with the occasional newline, backspace, cursor movement, and paste, in
+roughly the proportions of real editing. */
+static void generate_session(ReplayFrontend &frontend, int input_count)
+{
+    static const char *words[] = {"the", "editor", "buffer", "line", "int", "return", "const", "auto", "if", "for", "while", "std::string", "value", "index", "=", "{", "}", "();"};
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    std::string paste;
+
+    for (int i = 0; i < 40; i++)
+        paste += "    paste line " + std::to_string(i) + " with some text on it\n";
+
+    while (frontend.input_count() < input_count)
+    {
+        int roll = percent(rng);
+
+        if (roll < 75)
+        {
+            for (const char *c = words[rng() % std::size(words)]; *c != '\0'; c++)
+                frontend.add_key(static_cast<unsigned char>(*c));
+
+            frontend.add_key(' ');
+        }
+        else if (roll < 81)
+        {
+            frontend.add_key('\n');
+        }
+        else if (roll < 89)
+        {
+            frontend.add_key(KEY_BACKSPACE);
+        }
+        else if (roll < 99)
+        {
+            const int arrows[] = {KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN};
+            frontend.add_key(arrows[rng() % 4]);
+        }
+        else if (percent(rng) < 20)
+        {
+            frontend.add_paste(paste);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string trace_path;
+    std::string document_path;
+    int generate_count = 100000;
+    int burst = 1;
+    int rows = 50;
+    int cols = 160;
+    bool json = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--trace=", 0) == 0)
+            trace_path = arg.substr(8);
+        else if (arg.rfind("--generate=", 0) == 0)
+            generate_count = std::atoi(arg.c_str() + 11);
+        else if (arg.rfind("--burst=", 0) == 0)
+            burst = std::atoi(arg.c_str() + 8);
+        else if (arg.rfind("--rows=", 0) == 0)
+            rows = std::atoi(arg.c_str() + 7);
+        else if (arg.rfind("--cols=", 0) == 0)
+            cols = std::atoi(arg.c_str() + 7);
+        else if (arg == "--json")
+            json = true;
+        else if (arg.rfind("--", 0) != 0)
+            document_path = arg;
+        else
+        {
+            std::cerr << "unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    tracing::set_level_from_env();
+
+    auto frontend = std::make_unique<ReplayFrontend>(rows, cols);
+    ReplayFrontend &replay = *frontend;
+    replay.set_burst(burst);
+
+    if (!trace_path.empty())
+    {
+        std::ifstream trace(trace_path);
+
+        if (!trace || !replay.load(trace))
+        {
+            std::cerr << "couldn't read trace " << trace_path << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        generate_session(replay, generate_count);
+    }
+
+    int input_count = replay.input_count();
+    double seconds;
+
+    {
+        Editor editor = Editor(std::move(frontend));
+        editor.set_autosave_enabled(false);
+
+        if (!document_path.empty() && !editor.open_file(document_path))
+        {
+            std::cerr << "couldn't open " << document_path << std::endl;
+            return 1;
+        }
+
+        /* Only the replay itself is timed, not loading the document. */
+        tracing::reset_latency();
+
+        auto start = std::chrono::steady_clock::now();
+        editor.start_state_machine();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const tracing::Histogram &frames = tracing::histogram(tracing::Stage::FRAME);
+    double keys_per_second = input_count / seconds;
+
+    if (json)
+    {
+        std::printf("{\n");
+        std::printf("  \"inputs\": %d,\n", input_count);
+        std::printf("  \"burst\": %d,\n", burst);
+        std::printf("  \"seconds\": %.6f,\n", seconds);
+        std::printf("  \"keys_per_second\": %.1f,\n", keys_per_second);
+        std::printf("  \"latency_ns\": {\"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"p99.9\": %lld, \"max\": %lld}\n",
+                    static_cast<long long>(frames.percentile(50)), static_cast<long long>(frames.percentile(90)),
+                    static_cast<long long>(frames.percentile(99)), static_cast<long long>(frames.percentile(99.9)),
+                    static_cast<long long>(frames.max()));
+        std::printf("}\n");
+        return 0;
+    }
+
+    std::printf("replayed %d inputs in %.3f s (%.0f keys/s)\n\n", input_count, seconds, keys_per_second);
+    tracing::dump_latency(std::cout);
+}
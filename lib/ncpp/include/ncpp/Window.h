@@ -2,6 +2,10 @@
 
 #include "ncpp/ncpp.h"
 
+#include <string_view>
+#include <utility>
+#include <vector>
+
 namespace ncpp
 {
     class Window
@@ -19,9 +23,42 @@ namespace ncpp
 
         void move_cursor(const Cursor &cursor);
         void move_cursor(int row, int col);
-        void display_text(std::string text);
+
+        /* Displays text, one line per row. Only rows whose text actually changed are redrawn. */
+        void display_text(std::string_view text);
+
+        /* Sets the text of a single row, marking it as damaged if it changed. Damaged rows are only
+        drawn by the next reload(), so a caller that knows which lines changed (e.g. from edit
+        notifications) can update just those without re-displaying the whole window. */
+        void set_row(int win_row, std::string_view text);
+
+        /* Forces every row to be redrawn, e.g. after the window has been cleared or moved. */
+        void damage_all();
+
+        /* Sets the position (in the caller's coordinates) shown at the top left of the window, so
+        that move_cursor() can take positions in those coordinates (e.g. document rows/columns). */
+        void set_scroll(int top_row, int left_col);
+
+        /* Highlights the characters at marks (in the caller's coordinates, like move_cursor()), e.g.
+        to show cursors other than the terminal's own. Only the rows whose marks changed are
+        redrawn. Takes effect at the next reload(). */
+        void set_marks(const std::vector<Cursor> &marks);
         int get_input();
 
+        /* Like get_input(), but only waits up to milliseconds (zero doesn't wait at all) rather than
+        the input timeout, returning ERR if nothing arrives. Used to drain input that's already
+        pending before drawing. */
+        int poll_input(int milliseconds);
+
+        /* Returns (and clears) the text of the last paste, after get_input() returned PASTE. */
+        std::string take_paste();
+
+        /* Makes get_input() return ERR if no input arrives within the timeout. A negative timeout
+        blocks indefinitely (the default). */
+        void set_input_timeout(int milliseconds);
+
+        /* Draws the damaged rows and stages the window for output. Nothing reaches the terminal
+        until ncpp::update(), so several windows can be sent in a single write. */
         void reload();
         void resize(int new_height, int new_width);
         void reposition(int new_row, int new_col);
@@ -29,6 +66,13 @@ namespace ncpp
         int get_width();
         int get_height();
 
+        /* The screen position of the window's top left corner. */
+        int get_row();
+        int get_col();
+
+        /* Whether the screen position is inside the window (e.g. for mouse clicks). */
+        bool contains(int screen_row, int screen_col);
+
         void set_vertical_expansion(bool value);
         void set_horizontal_expansion(bool value);
         bool expands_vertically();
@@ -49,5 +93,26 @@ namespace ncpp
         std::string current_text = "";
         std::string fill_pattern = "";
         std::string preamble = "";
+
+        int scroll_row = 0;
+        int scroll_col = 0;
+
+        /* What each row currently shows, and whether it needs redrawing. */
+        std::vector<std::string> row_text;
+        std::vector<bool> row_damaged;
+
+        /* Whether the rows were last laid out from current_text by display_text(), rather than set
+        one at a time with set_row(), in which case current_text is stale and mustn't be laid out
+        again (e.g. on a resize). */
+        bool rows_from_text = true;
+
+        /* The highlighted characters, in window coordinates, sorted. */
+        std::vector<std::pair<int, int>> marks;
+
+        int input_timeout = -1;
+        std::string paste_text = "";
+
+        bool read_sequence(const std::string &sequence);
+        void read_paste();
     };
 }
\ No newline at end of file
@@ -18,11 +18,33 @@ namespace ncpp
     static constexpr int CTRL_X = static_cast<int>('x') & (0x1f);
     static constexpr int CTRL_Q = static_cast<int>('q') & (0x1f);
     static constexpr int CTRL_S = static_cast<int>('s') & (0x1f);
+    static constexpr int CTRL_T = static_cast<int>('t') & (0x1f);
+    static constexpr int CTRL_L = static_cast<int>('l') & (0x1f);
+    static constexpr int CTRL_Z = static_cast<int>('z') & (0x1f);
+    static constexpr int CTRL_Y = static_cast<int>('y') & (0x1f);
+    static constexpr int CTRL_F = static_cast<int>('f') & (0x1f);
+    static constexpr int CTRL_N = static_cast<int>('n') & (0x1f);
+    static constexpr int CTRL_R = static_cast<int>('r') & (0x1f);
+    static constexpr int CTRL_D = static_cast<int>('d') & (0x1f);
+
+    static constexpr int ESCAPE = 27;
+
+    /* Returned by Window::get_input() when a bracketed paste has been read. The pasted text is
+    retrieved with Window::take_paste(). */
+    static constexpr int PASTE = KEY_MAX + 1;
 
     void init();
 
+    /* Initialises ncurses with a screen of the given size whose output goes to /dev/null, so the
+    windows can be driven (and their rendering costs measured) without a terminal. cleanup() tears
+    it down as usual. */
+    void init_headless(int rows, int cols);
+
     void cleanup();
 
+    /* Sends everything staged by Window::reload() to the terminal in one go. */
+    void update();
+
     int ctrl(char c);
 
     bool is_backspace(int c);
@@ -1,17 +1,31 @@
 #include "ncpp/Window.h"
 
+#include <tracing/Latency.h>
+
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 // TODO: use string_view instead of string
 
 namespace ncpp
 {
+    /* Bracketed paste markers, minus the leading escape for the start marker (which has already been
+    read by the time it's checked for). */
+    static const std::string PASTE_START = "[200~";
+    static const std::string PASTE_END = "\033[201~";
+
+    static constexpr int ESCAPE_SEQUENCE_TIMEOUT_MS = 25;
+
     Window::Window() : Window(0, 0, 0, 0) {};
 
     Window::Window(int win_height, int win_width, int win_row, int win_col, std::string fill) : height(win_height), width(win_width), row(win_row), col(win_col), fill_pattern(fill)
     {
         window_ptr = newwin(height, width, row, col);
         keypad(window_ptr, true);
+
+        row_text.resize(height);
+        row_damaged.resize(height);
     }
 
     Window::~Window()
@@ -26,13 +40,55 @@ namespace ncpp
 
     void Window::move_cursor(int row, int col)
     {
-        wmove(window_ptr, row, row == 0 ? col + preamble.length() : col);
+        int win_row = row - scroll_row;
+        int win_col = col - scroll_col;
+
+        wmove(window_ptr, win_row, win_row == 0 ? win_col + preamble.length() : win_col);
+    }
+
+    void Window::set_scroll(int top_row, int left_col)
+    {
+        scroll_row = top_row;
+        scroll_col = left_col;
+    }
+
+    void Window::set_marks(const std::vector<Cursor> &new_marks)
+    {
+        std::vector<std::pair<int, int>> visible;
+
+        for (const Cursor &mark : new_marks)
+        {
+            int win_row = mark.row - scroll_row;
+            int win_col = mark.col - scroll_col + (win_row == 0 ? static_cast<int>(preamble.length()) : 0);
+
+            if (win_row >= 0 && win_row < height && win_col >= 0 && win_col < width)
+                visible.emplace_back(win_row, win_col);
+        }
+
+        std::sort(visible.begin(), visible.end());
+
+        if (visible == marks)
+            return;
+
+        /* Rows that gain or lose a mark are redrawn, which adds or clears the highlight. */
+        for (auto [win_row, win_col] : marks)
+        {
+            if (win_row < height)
+                row_damaged[win_row] = true;
+        }
+
+        for (auto [win_row, win_col] : visible)
+            row_damaged[win_row] = true;
+
+        marks = std::move(visible);
     }
 
-    void Window::display_text(std::string text)
+    void Window::display_text(std::string_view text)
     {
         current_text = text;
-        std::string filled_text = preamble + text;
+
+        std::string filled_text = preamble;
+        filled_text += text;
 
         if (fill_pattern != "")
         {
@@ -45,19 +101,178 @@ namespace ncpp
             }
         }
 
-        werase(window_ptr);
-        wprintw(window_ptr, filled_text.c_str());
+        std::string::size_type line_start = 0;
+
+        for (int line_row = 0; line_row < height; line_row++)
+        {
+            if (line_start > filled_text.length())
+            {
+                set_row(line_row, "");
+                continue;
+            }
+
+            std::string::size_type line_end = filled_text.find('\n', line_start);
+
+            if (line_end == std::string::npos)
+                line_end = filled_text.length();
+
+            set_row(line_row, std::string_view(filled_text).substr(line_start, line_end - line_start));
+
+            line_start = line_end + 1;
+        }
+
+        rows_from_text = true;
         reload();
     }
 
+    void Window::set_row(int win_row, std::string_view text)
+    {
+        rows_from_text = false;
+
+        if (win_row < 0 || win_row >= height)
+            return;
+
+        /* Lines are clipped rather than wrapped, so each line of text always stays on its own row. */
+        text = text.substr(0, std::max(width, 0));
+
+        if (row_text[win_row] == text)
+            return;
+
+        row_text[win_row] = text;
+        row_damaged[win_row] = true;
+    }
+
+    void Window::damage_all()
+    {
+        std::fill(row_damaged.begin(), row_damaged.end(), true);
+    }
+
     int Window::get_input()
     {
-        return wgetch(window_ptr);
+        int input = wgetch(window_ptr);
+
+        if (input == ERR)
+            return input;
+
+        /* The key has arrived, so the time until the screen is updated counts against it. */
+        tracing::begin_frame();
+        TIME_STAGE(tracing::Stage::INPUT);
+
+        if (input == ESCAPE && read_sequence(PASTE_START))
+        {
+            read_paste();
+            return PASTE;
+        }
+
+        return input;
+    }
+
+    int Window::poll_input(int milliseconds)
+    {
+        /* Swapped in as the input timeout (rather than just passed to wtimeout()), so that reading
+        the rest of an escape sequence or paste puts back the right one. */
+        int timeout = input_timeout;
+        set_input_timeout(milliseconds);
+
+        int input = get_input();
+
+        set_input_timeout(timeout);
+        return input;
+    }
+
+    std::string Window::take_paste()
+    {
+        return std::exchange(paste_text, "");
+    }
+
+    void Window::set_input_timeout(int milliseconds)
+    {
+        input_timeout = milliseconds;
+        wtimeout(window_ptr, milliseconds);
+    }
+
+    bool Window::read_sequence(const std::string &sequence)
+    {
+        /* The rest of an escape sequence arrives straight after the escape, so only wait briefly. */
+        wtimeout(window_ptr, ESCAPE_SEQUENCE_TIMEOUT_MS);
+
+        std::vector<int> read;
+
+        for (char expected : sequence)
+        {
+            int input = wgetch(window_ptr);
+
+            if (input != ERR)
+                read.push_back(input);
+
+            if (input != expected)
+                break;
+        }
+
+        wtimeout(window_ptr, input_timeout);
+
+        if (read.size() == sequence.size() && std::equal(sequence.begin(), sequence.end(), read.begin()))
+            return true;
+
+        /* Not the sequence, so put everything back to be read as normal input. ungetch() pushes onto
+        a stack, hence the reverse order. */
+        for (auto itr = read.rbegin(); itr != read.rend(); itr++)
+            ungetch(*itr);
+
+        return false;
+    }
+
+    void Window::read_paste()
+    {
+        paste_text.clear();
+
+        /* The whole paste is already on its way, so block until the end sequence shows up. */
+        wtimeout(window_ptr, -1);
+
+        int previous = ERR;
+
+        while (!paste_text.ends_with(PASTE_END))
+        {
+            int input = wgetch(window_ptr);
+
+            if (input == ERR)
+                break;
+
+            /* Terminals send line breaks in pastes as carriage returns (sometimes followed by a
+            newline), so turn each of those into a single newline. */
+            if (!(input == '\n' && previous == '\r'))
+                paste_text += input == '\r' ? '\n' : static_cast<char>(input);
+
+            previous = input;
+        }
+
+        wtimeout(window_ptr, input_timeout);
+
+        if (paste_text.ends_with(PASTE_END))
+            paste_text.resize(paste_text.size() - PASTE_END.size());
     }
 
     void Window::reload()
     {
-        wrefresh(window_ptr);
+        for (int win_row = 0; win_row < height; win_row++)
+        {
+            if (!row_damaged[win_row])
+                continue;
+
+            /* Clear first, as writing into the final column moves the cursor onto the next row. */
+            wmove(window_ptr, win_row, 0);
+            wclrtoeol(window_ptr);
+            waddnstr(window_ptr, row_text[win_row].c_str(), static_cast<int>(row_text[win_row].length()));
+
+            auto mark = std::lower_bound(marks.begin(), marks.end(), std::make_pair(win_row, 0));
+
+            for (; mark != marks.end() && mark->first == win_row; mark++)
+                mvwchgat(window_ptr, win_row, mark->second, 1, A_REVERSE, 0, nullptr);
+
+            row_damaged[win_row] = false;
+        }
+
+        wnoutrefresh(window_ptr);
     }
 
     void Window::resize(int new_height, int new_width)
@@ -69,7 +284,23 @@ namespace ncpp
         height = new_height;
 
         wresize(window_ptr, new_height, new_width);
-        display_text(current_text);
+
+        row_text.resize(height);
+        row_damaged.resize(height);
+        damage_all();
+
+        if (rows_from_text)
+        {
+            display_text(current_text);
+            return;
+        }
+
+        /* The rows' owner redraws them for the new size, but until then, they mustn't run past the
+        new width. */
+        for (std::string &text : row_text)
+            text.resize(std::min(text.size(), static_cast<std::size_t>(std::max(width, 0))));
+
+        reload();
     }
 
     void Window::reposition(int new_row, int new_col)
@@ -82,7 +313,13 @@ namespace ncpp
 
         werase(window_ptr);
         mvwin(window_ptr, new_row, new_col);
-        display_text(current_text);
+
+        damage_all();
+
+        if (rows_from_text)
+            display_text(current_text);
+        else
+            reload();
     }
 
     int Window::get_width()
@@ -95,6 +332,21 @@ namespace ncpp
         return height;
     }
 
+    int Window::get_row()
+    {
+        return row;
+    }
+
+    int Window::get_col()
+    {
+        return col;
+    }
+
+    bool Window::contains(int screen_row, int screen_col)
+    {
+        return screen_row >= row && screen_row < row + height && screen_col >= col && screen_col < col + width;
+    }
+
     void Window::set_vertical_expansion(bool value) { expand_vertically = value; }
     void Window::set_horizontal_expansion(bool value) { expand_horizontally = value; }
 
@@ -1,7 +1,20 @@
 #include "ncpp/ncpp.h"
 
+#include <tracing/Latency.h>
+
+#include <cstdio>
+#include <cstdlib>
+
 namespace ncpp
 {
+    namespace
+    {
+        /* Set while running headless (see init_headless()). */
+        SCREEN *headless_screen = nullptr;
+        std::FILE *headless_out = nullptr;
+        std::FILE *headless_in = nullptr;
+    } /* namespace */
+
     void init()
     {
         initscr();
@@ -9,13 +22,58 @@ namespace ncpp
         keypad(stdscr, true);
         raw();
         // mousemask(ALL_MOUSE_EVENTS, NULL);
+
+        /* Ask the terminal to wrap pastes in escape sequences, so they can be read as one input. */
+        std::fputs("\033[?2004h", stdout);
+        std::fflush(stdout);
+    }
+
+    void init_headless(int rows, int cols)
+    {
+        headless_out = std::fopen("/dev/null", "w");
+        headless_in = std::fopen("/dev/null", "r");
+
+        /* The terminal type only decides which escape sequences get written to /dev/null, but it
+        still needs to exist, so fall back to one that always does. */
+        const char *term = std::getenv("TERM");
+        headless_screen = newterm(term != nullptr && *term != '\0' ? term : "xterm", headless_out, headless_in);
+
+        if (headless_screen == nullptr)
+            headless_screen = newterm("xterm", headless_out, headless_in);
+
+        set_term(headless_screen);
+        resizeterm(rows, cols);
+
+        noecho();
+        keypad(stdscr, true);
     }
 
     void cleanup()
     {
+        if (headless_screen != nullptr)
+        {
+            endwin();
+            delscreen(headless_screen);
+
+            std::fclose(headless_out);
+            std::fclose(headless_in);
+
+            headless_screen = nullptr;
+            return;
+        }
+
+        std::fputs("\033[?2004l", stdout);
+        std::fflush(stdout);
+
         endwin();
     }
 
+    void update()
+    {
+        doupdate();
+        tracing::end_frame();
+    }
+
     int ctrl(char c)
     {
         return static_cast<int>(c) & (0x1f);
@@ -0,0 +1,73 @@
+#include <text_buffer/TextBuffer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/* Measures the cost of moving the gap as a function of how far the cursor moves. The document is a
+single line, so cursor positions map directly to byte offsets and no line metadata work is mixed
+into the timings. Each iteration jumps the cursor by the given distance and inserts a character,
+which forces the gap to relocate. */
+
+static void fill(TextBuffer &text, int size)
+{
+    for (int i = 0; i < size; i++)
+        text.insert('a' + (i % 26));
+}
+
+static double time_moves(TextBuffer &text, int base, int distance, int iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        text.set_cursor_pos(0, (i % 2 == 0) ? base + distance : base);
+        text.insert('x');
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> sizes_mb;
+
+    for (int i = 1; i < argc; i++)
+        sizes_mb.push_back(std::atoi(argv[i]));
+
+    if (sizes_mb.empty())
+        sizes_mb = {1, 100};
+
+    const std::vector<int> distances = {1, 16, 256, 4 << 10, 64 << 10, 1 << 20, 16 << 20};
+
+    std::printf("%10s %12s %14s %12s\n", "doc (MB)", "distance", "ns/move", "GB/s");
+
+    for (int size_mb : sizes_mb)
+    {
+        int size = size_mb * 1024 * 1024;
+
+        TextBuffer text;
+        fill(text, size);
+
+        for (int distance : distances)
+        {
+            if (distance >= size)
+                break;
+
+            /* Keep the number of bytes moved per distance roughly constant, so each row takes a
+            similar amount of time. */
+            int iterations = std::clamp((256 << 20) / distance, 20, 200000);
+
+            /* Start in the middle so both directions stay inside the document. */
+            int base = (size - distance) / 2;
+
+            double ns_per_move = time_moves(text, base, distance, iterations);
+            double gb_per_sec = distance / ns_per_move;
+
+            std::printf("%10d %12d %14.1f %12.2f\n", size_mb, distance, ns_per_move, gb_per_sec);
+        }
+    }
+}
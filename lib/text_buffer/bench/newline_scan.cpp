@@ -0,0 +1,93 @@
+#include <text_buffer/NewlineScan.h>
+#include <text_buffer/TextMetadata.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+/* Compares the newline scanning kernels against each other (the scalar kernel being the plain
+byte-at-a-time loop), and times a full TextMetadata rebuild on top of the best one. */
+
+static std::string make_text(std::size_t size, int average_line_len)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> line_len(0, average_line_len * 2);
+
+    std::string text;
+    text.reserve(size);
+
+    while (text.size() < size)
+    {
+        int len = line_len(rng);
+
+        for (int i = 0; i < len && text.size() < size; i++)
+            text += static_cast<char>('a' + (rng() % 26));
+
+        if (text.size() < size)
+            text += '\n';
+    }
+
+    return text;
+}
+
+template <typename Fn>
+static double time_best_of(int runs, Fn fn)
+{
+    double best = 0;
+
+    for (int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+
+        if (i == 0 || seconds < best)
+            best = seconds;
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t size_mb = argc > 1 ? std::atoi(argv[1]) : 100;
+    int average_line_len = argc > 2 ? std::atoi(argv[2]) : 80;
+
+    std::string text = make_text(size_mb * 1024 * 1024, average_line_len);
+    std::vector<int> positions(text.size());
+
+    const std::pair<ScanKernel, const char *> kernels[] = {
+        {ScanKernel::SCALAR, "scalar"},
+        {ScanKernel::SSE2, "sse2"},
+        {ScanKernel::AVX2, "avx2"},
+    };
+
+    std::printf("%zu MB, average line length %d\n", size_mb, average_line_len);
+    std::printf("%-16s %10s %10s %12s\n", "kernel", "ms", "GB/s", "newlines");
+
+    for (auto [kernel, name] : kernels)
+    {
+        if (!scan_kernel_supported(kernel))
+        {
+            std::printf("%-16s %10s\n", name, "unsupported");
+            continue;
+        }
+
+        std::size_t count = 0;
+        double seconds = time_best_of(5, [&]
+                                      { count = find_newlines(kernel, text.data(), text.size(), positions.data()); });
+
+        std::printf("%-16s %10.2f %10.2f %12zu\n", name, seconds * 1000, text.size() / seconds / 1e9, count);
+    }
+
+    TextMetadata metadata;
+    double seconds = time_best_of(3, [&]
+                                  { metadata.rebuild(text); });
+
+    std::printf("%-16s %10.2f %10.2f %12d\n", "metadata rebuild", seconds * 1000, text.size() / seconds / 1e9, metadata.line_count() - 1);
+}
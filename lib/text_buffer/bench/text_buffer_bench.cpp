@@ -0,0 +1,545 @@
+#include <text_buffer/TextBuffer.h>
+#include <text_buffer/StatsWorker.h>
+#include <text_buffer/TextSearch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/* Benchmarks the everyday TextBuffer operations over documents from 1 KB to 1 GB, for both storage
+backends. Works like Google Benchmark (and takes the same basic flags), but has no dependencies:
+each benchmark's iteration count is grown until a run takes at least the minimum time, and the
+results can be written as JSON for tracking across commits.
+
+    text_buffer_bench [--benchmark_filter=<substring>] [--benchmark_min_time=<seconds>]
+                      [--benchmark_format=console|json] [--benchmark_out=<file>]
+                      [--max_size=<bytes>] [--storage=gap|piece|both]
+
+Benchmark names are <operation>/<storage>/<size>, e.g. insert_middle/piece/1048576. */
+
+namespace
+{
+    constexpr int LINE_LEN = 64;
+    constexpr int PASTE_SIZE = 64 * 1024;
+    constexpr std::size_t BUILD_CHUNK_SIZE = 1 << 20;
+    constexpr int MULTI_CURSOR_COUNT = 10000;
+
+    struct Options
+    {
+        std::string filter;
+        double min_time = 0.5;
+        bool json = false;
+        std::string out_path;
+        std::size_t max_size = std::size_t(1) << 30;
+        bool gap = true;
+        bool piece = true;
+    };
+
+    /* What a benchmark runs against. The buffer is built once per benchmark, outside the timings. */
+    struct Fixture
+    {
+        std::unique_ptr<TextBuffer> text;
+        std::size_t size;
+        std::mt19937 rng{42};
+
+        /* Random (row, col) positions, cycled through by benchmarks that need them, so that the
+        random number generation isn't part of what's timed. */
+        std::vector<std::pair<int, int>> positions;
+    };
+
+    struct Benchmark
+    {
+        const char *name;
+        std::function<void(Fixture &, long)> run;
+
+        /* How many bytes each iteration processes (for bytes_per_second), or 0 if not meaningful. */
+        std::function<std::size_t(const Fixture &)> bytes_per_iteration = nullptr;
+
+        /* The most iterations a run can do, e.g. so that backspace doesn't empty the document. */
+        std::function<long(const Fixture &)> max_iterations = nullptr;
+    };
+
+    struct Result
+    {
+        std::string name;
+        long iterations;
+        double real_ns;
+        double cpu_ns;
+        double bytes_per_second;
+    };
+
+    /* Lines of LINE_LEN - 1 letters, each followed by a newline. */
+    std::string make_chunk(std::size_t size, std::size_t offset)
+    {
+        std::string chunk(size, '\n');
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            if ((offset + i) % LINE_LEN != LINE_LEN - 1)
+                chunk[i] = static_cast<char>('a' + (offset + i) % 26);
+        }
+
+        return chunk;
+    }
+
+    /* Gap buffers are built by inserting (as if pasted or typed), piece tables by opening a file (as
+    that's how they are normally created), so each is benchmarked in its usual state. */
+    std::unique_ptr<TextBuffer> build(StorageKind kind, std::size_t size)
+    {
+        auto text = std::make_unique<TextBuffer>(kind);
+
+        if (kind == StorageKind::GAP_BUFFER)
+        {
+            for (std::size_t offset = 0; offset < size; offset += BUILD_CHUNK_SIZE)
+                text->insert(std::string_view(make_chunk(std::min(BUILD_CHUNK_SIZE, size - offset), offset)));
+
+            return text;
+        }
+
+        std::string path = "/tmp/text_buffer_bench." + std::to_string(getpid());
+
+        {
+            std::ofstream file(path, std::ofstream::binary | std::ofstream::trunc);
+
+            for (std::size_t offset = 0; offset < size; offset += BUILD_CHUNK_SIZE)
+            {
+                std::string chunk = make_chunk(std::min(BUILD_CHUNK_SIZE, size - offset), offset);
+                file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            }
+        }
+
+        /* The mapping stays valid after the file is unlinked. */
+        bool opened = text->open(path);
+        std::remove(path.c_str());
+
+        if (!opened)
+        {
+            std::fprintf(stderr, "couldn't open %s\n", path.c_str());
+            std::exit(1);
+        }
+
+        /* Index every line up front, so that the cases time editing in the usual state rather than
+        the lazy indexing done after opening. */
+        text->index_to_line(std::numeric_limits<int>::max());
+
+        return text;
+    }
+
+    Fixture make_fixture(StorageKind kind, std::size_t size)
+    {
+        Fixture fixture;
+        fixture.text = build(kind, size);
+        fixture.size = size;
+
+        int line_count = fixture.text->get_line_count();
+        std::uniform_int_distribution<int> row(0, line_count - 1);
+        std::uniform_int_distribution<int> col(0, LINE_LEN - 1);
+
+        for (int i = 0; i < 1024; i++)
+            fixture.positions.emplace_back(row(fixture.rng), col(fixture.rng));
+
+        return fixture;
+    }
+
+    const std::pair<int, int> &next_position(Fixture &fixture, long i)
+    {
+        return fixture.positions[static_cast<std::size_t>(i) % fixture.positions.size()];
+    }
+
+    /* Stops the compiler from optimising away a result. */
+    template <typename T>
+    void do_not_optimise(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    const std::vector<Benchmark> &benchmarks()
+    {
+        static const std::string paste = make_chunk(PASTE_SIZE, 0);
+
+        static const std::vector<Benchmark> all = {
+            {"insert_start", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     f.text->set_cursor_pos(0, 0);
+                     f.text->insert('x');
+                 }
+             }},
+            {"insert_middle", [](Fixture &f, long iterations)
+             {
+                 int middle = f.text->get_line_count() / 2;
+
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     f.text->set_cursor_pos(middle, 0);
+                     f.text->insert('x');
+                 }
+             }},
+            {"insert_end", [](Fixture &f, long iterations)
+             {
+                 int last = f.text->get_line_count() - 1;
+
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     f.text->set_cursor_pos(last, f.text->get_line_length(last));
+                     f.text->insert('x');
+                 }
+             }},
+            {"backspace", [](Fixture &f, long iterations)
+             {
+                 f.text->set_cursor_pos(f.text->get_line_count() / 2, 0);
+
+                 for (long i = 0; i < iterations; i++)
+                     f.text->pop();
+             },
+             nullptr, [](const Fixture &f)
+             { return static_cast<long>(f.text->get_text().size() / 4); }},
+            {"cursor_jump", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     auto [row, col] = next_position(f, i);
+                     f.text->set_cursor_pos(row, col);
+                 }
+             }},
+            {"get_text_view", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     std::size_t sum = 0;
+                     f.text->get_text().for_each_segment([&sum](std::span<const char> segment)
+                                                         { sum += segment.size(); });
+                     do_not_optimise(sum);
+                 }
+             }},
+            {"get_text_copy", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     std::string text = f.text->get_text().to_string();
+                     do_not_optimise(text.data());
+                 }
+             },
+             [](const Fixture &f)
+             { return static_cast<std::size_t>(f.text->get_text().size()); }},
+            {"line_count", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     int row = next_position(f, i).first;
+                     do_not_optimise(f.text->get_line_count() + f.text->get_line_length(row));
+                 }
+             }},
+            {"get_line", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     std::size_t sum = 0;
+                     f.text->get_line(next_position(f, i).first, 0, 80).for_each_segment([&sum](std::span<const char> segment)
+                                                                                          { sum += segment.size(); });
+                     do_not_optimise(sum);
+                 }
+             }},
+            {"paste_64k", [](Fixture &f, long iterations)
+             {
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     auto [row, col] = next_position(f, i);
+                     f.text->set_cursor_pos(row, col);
+                     f.text->insert(std::string_view(paste));
+                 }
+             },
+             [](const Fixture &)
+             { return static_cast<std::size_t>(PASTE_SIZE); },
+             /* Don't let the document grow by more than 64 MB. */
+             [](const Fixture &)
+             { return 1024L; }},
+            /* Typing at a column of cursors, one per line (up to MULTI_CURSOR_COUNT of them). The
+            cursors are only placed on the first run, so later (longer) runs don't time it. */
+            {"multi_cursor_type", [](Fixture &f, long iterations)
+             {
+                 if (f.text->get_extra_cursors().empty())
+                 {
+                     int cursor_count = std::min(MULTI_CURSOR_COUNT, f.text->get_line_count());
+                     f.text->set_cursor_pos(0, LINE_LEN / 2);
+
+                     for (int row = 1; row < cursor_count; row++)
+                         f.text->add_cursor(row, LINE_LEN / 2);
+                 }
+
+                 for (long i = 0; i < iterations; i++)
+                     f.text->insert('x');
+             },
+             nullptr,
+             /* Don't let the document grow by more than 64 MB. */
+             [](const Fixture &)
+             { return 64L * 1024 * 1024 / MULTI_CURSOR_COUNT; }},
+            /* Full scans, as the pattern never occurs (consecutive letters always differ). */
+            {"search_literal", [](Fixture &f, long iterations)
+             {
+                 static TextSearch search;
+
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     search.start(f.text->snapshot(), "qqq", SearchMode::LITERAL);
+                     search.wait();
+                     do_not_optimise(search.status().match_count);
+                 }
+             },
+             [](const Fixture &f)
+             { return f.size; }},
+            {"search_regex", [](Fixture &f, long iterations)
+             {
+                 static TextSearch search;
+
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     search.start(f.text->snapshot(), "q[0-9]q", SearchMode::REGEX);
+                     search.wait();
+                     do_not_optimise(search.status().match_count);
+                 }
+             },
+             [](const Fixture &f)
+             { return f.size; }},
+            /* Recounting the statistics after a keystroke, which only reads the text around it again
+            (for a piece table). The first run counts everything. */
+            {"stats_after_edit", [](Fixture &f, long iterations)
+             {
+                 static StatsWorker stats;
+
+                 for (long i = 0; i < iterations; i++)
+                 {
+                     auto [row, col] = next_position(f, i);
+                     f.text->set_cursor_pos(row, col);
+                     f.text->insert('x');
+
+                     stats.update(f.text->snapshot(), static_cast<int>(i));
+                     stats.wait();
+                     do_not_optimise(stats.stats().word_count);
+                 }
+             }},
+        };
+
+        return all;
+    }
+
+    double process_cpu_ns()
+    {
+        timespec now;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+        return now.tv_sec * 1e9 + now.tv_nsec;
+    }
+
+    Result run_benchmark(const Benchmark &benchmark, Fixture &fixture, const std::string &name, double min_time)
+    {
+        long max_iterations = benchmark.max_iterations ? std::max(1L, benchmark.max_iterations(fixture)) : 1'000'000'000L;
+        long iterations = 1;
+
+        /* Grow the iteration count until a run is long enough to time reliably, in the same way as
+        Google Benchmark. */
+        while (true)
+        {
+            auto start = std::chrono::steady_clock::now();
+            double cpu_start = process_cpu_ns();
+
+            benchmark.run(fixture, iterations);
+
+            double cpu_ns = process_cpu_ns() - cpu_start;
+            double real_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            double seconds = real_ns / 1e9;
+
+            if (seconds >= min_time || iterations >= max_iterations)
+            {
+                double bytes = benchmark.bytes_per_iteration ? static_cast<double>(benchmark.bytes_per_iteration(fixture)) : 0;
+                double bytes_per_second = bytes * iterations / std::max(seconds, 1e-9);
+
+                return Result{name, iterations, real_ns / iterations, cpu_ns / iterations, bytes_per_second};
+            }
+
+            /* Aim for the minimum time with some headroom, but never grow more than 10x at once. */
+            double scale = seconds <= 0 ? 10.0 : std::min(10.0, 1.4 * min_time / seconds);
+            iterations = std::min(max_iterations, std::max(iterations + 1, static_cast<long>(iterations * scale)));
+        }
+    }
+
+    std::string json_escape(const std::string &text)
+    {
+        std::string escaped;
+
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+
+            escaped += c;
+        }
+
+        return escaped;
+    }
+
+    void write_json(std::FILE *out, const std::vector<Result> &results, const char *executable)
+    {
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+        std::fprintf(out, "{\n  \"context\": {\n");
+        std::fprintf(out, "    \"date\": \"%s\",\n", date);
+        std::fprintf(out, "    \"executable\": \"%s\",\n", json_escape(executable).c_str());
+        std::fprintf(out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+        std::fprintf(out, "    \"library_build_type\": \"release\"\n");
+#else
+        std::fprintf(out, "    \"library_build_type\": \"debug\"\n");
+#endif
+        std::fprintf(out, "  },\n  \"benchmarks\": [\n");
+
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+
+            std::fprintf(out, "    {\n");
+            std::fprintf(out, "      \"name\": \"%s\",\n", json_escape(result.name).c_str());
+            std::fprintf(out, "      \"run_type\": \"iteration\",\n");
+            std::fprintf(out, "      \"iterations\": %ld,\n", result.iterations);
+            std::fprintf(out, "      \"real_time\": %.3f,\n", result.real_ns);
+            std::fprintf(out, "      \"cpu_time\": %.3f,\n", result.cpu_ns);
+            std::fprintf(out, "      \"time_unit\": \"ns\"");
+
+            if (result.bytes_per_second > 0)
+                std::fprintf(out, ",\n      \"bytes_per_second\": %.1f", result.bytes_per_second);
+
+            std::fprintf(out, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+    bool parse_flag(const std::string &arg, const char *flag, std::string &value)
+    {
+        std::string prefix = std::string(flag) + "=";
+
+        if (arg.compare(0, prefix.size(), prefix) != 0)
+            return false;
+
+        value = arg.substr(prefix.size());
+        return true;
+    }
+
+    Options parse_options(int argc, char *argv[])
+    {
+        Options options;
+
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            std::string value;
+
+            if (parse_flag(arg, "--benchmark_filter", value))
+                options.filter = value;
+            else if (parse_flag(arg, "--benchmark_min_time", value))
+                options.min_time = std::atof(value.c_str());
+            else if (parse_flag(arg, "--benchmark_format", value))
+                options.json = value == "json";
+            else if (parse_flag(arg, "--benchmark_out", value))
+                options.out_path = value;
+            else if (parse_flag(arg, "--max_size", value))
+                options.max_size = std::strtoull(value.c_str(), nullptr, 10);
+            else if (parse_flag(arg, "--storage", value))
+            {
+                options.gap = value != "piece";
+                options.piece = value != "gap";
+            }
+            else
+            {
+                std::fprintf(stderr, "unknown argument: %s\n", argv[i]);
+                std::exit(1);
+            }
+        }
+
+        return options;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options = parse_options(argc, argv);
+
+    /* Every 32x from 1 KB to 1 GB. */
+    const std::vector<std::size_t> sizes = {1 << 10, 1 << 15, 1 << 20, 1 << 25, 1 << 30};
+
+    std::vector<std::pair<StorageKind, const char *>> kinds;
+
+    if (options.gap)
+        kinds.emplace_back(StorageKind::GAP_BUFFER, "gap");
+    if (options.piece)
+        kinds.emplace_back(StorageKind::PIECE_TABLE, "piece");
+
+    std::vector<Result> results;
+
+    if (!options.json)
+        std::printf("%-36s %14s %14s %12s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "MB/s");
+
+    for (std::size_t size : sizes)
+    {
+        if (size > options.max_size)
+            break;
+
+        for (auto [kind, kind_name] : kinds)
+        {
+            for (const Benchmark &benchmark : benchmarks())
+            {
+                std::string name = std::string(benchmark.name) + "/" + kind_name + "/" + std::to_string(size);
+
+                if (name.find(options.filter) == std::string::npos)
+                    continue;
+
+                /* A fresh fixture per benchmark, so that one benchmark's edits don't skew the next. */
+                Fixture fixture = make_fixture(kind, size);
+                Result result = run_benchmark(benchmark, fixture, name, options.min_time);
+                results.push_back(result);
+
+                if (!options.json)
+                {
+                    std::printf("%-36s %14.1f %14.1f %12ld", result.name.c_str(), result.real_ns, result.cpu_ns, result.iterations);
+
+                    if (result.bytes_per_second > 0)
+                        std::printf(" %12.1f", result.bytes_per_second / 1e6);
+
+                    std::printf("\n");
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+
+    if (options.json)
+        write_json(stdout, results, argv[0]);
+
+    if (!options.out_path.empty())
+    {
+        std::FILE *out = std::fopen(options.out_path.c_str(), "w");
+
+        if (out == nullptr)
+        {
+            std::fprintf(stderr, "couldn't write %s\n", options.out_path.c_str());
+            return 1;
+        }
+
+        write_json(out, results, argv[0]);
+        std::fclose(out);
+    }
+}
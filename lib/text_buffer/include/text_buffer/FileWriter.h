@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "TextSnapshot.h"
+#include "TextView.h"
+
+/* How hard write_file() tries to make a save survive a crash or power loss. The rename is atomic
+either way, so a crash mid-save never leaves a half-written file; syncing additionally makes sure
+the new contents have actually reached the disk before the old file is replaced. */
+enum class SyncPolicy
+{
+    /* Leave flushing to the OS. Fastest, but after a power loss the file may be empty or stale. */
+    NONE,
+
+    /* fsync() the new file before renaming it over the old one. */
+    FILE,
+
+    /* As FILE, and also fsync() the directory so that the rename itself is durable. */
+    FILE_AND_DIRECTORY
+};
+
+/* Writes text to file_path by streaming its segments straight from the storage with writev(), so
+no contiguous copy of the text is ever made. The text is written to a temporary file in the same
+directory, which is then renamed over file_path.
+
+Renaming (rather than overwriting in place) also matters because file_path may be the file the text
+is memory-mapped from: the old mapping stays valid, as it keeps the replaced file alive.
+
+Returns false (leaving file_path untouched) if anything fails. */
+bool write_file(const std::string &file_path, const TextView &text, SyncPolicy sync = SyncPolicy::FILE);
+
+/* Called as a write progresses, with the number of bytes written so far. */
+using WriteProgress = std::function<void(std::size_t bytes_written)>;
+
+/* As above, but writes a snapshot, so can run on another thread while the text is being edited. */
+bool write_file(const std::string &file_path, const TextSnapshot &text, SyncPolicy sync = SyncPolicy::FILE, const WriteProgress &progress = nullptr);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "TextStorage.h"
+
+/* Controls how the gap grows and shrinks. The gap is sized relative to the length of the text, so the
+bytes copied by reallocations stay proportional to the bytes inserted (i.e. inserts are amortised O(1)). */
+struct GapPolicy
+{
+    /* Bounds on the size of a newly grown gap. An insert larger than max_gap still gets a gap big
+    enough to hold it. */
+    int min_gap = 64;
+    int max_gap = 64 * 1024 * 1024;
+
+    /* Size of a newly grown gap, as a fraction of the text length. */
+    double growth_factor = 0.5;
+
+    /* When idle, the gap is shrunk back to its target size once it exceeds this multiple of it. */
+    double shrink_factor = 4.0;
+};
+
+/* A single contiguous buffer with a gap at the most recent edit position. Edits next to the gap are
+O(1), and moving the gap costs the distance it moves. */
+class GapBuffer : public TextStorage
+{
+public:
+    GapBuffer();
+    explicit GapBuffer(GapPolicy gap_policy);
+
+    void insert(int index, std::string_view text) override;
+    void erase(int index, int length) override;
+
+    /* Sweeps the gap through the replacements once, leaving it after the last, so this costs the
+    distance from the first replacement to the last (plus the gap move to the first), however many
+    replacements there are, rather than a gap move per replacement. */
+    void replace(std::span<const Replacement> replacements) override;
+    std::string read(int index, int length) override;
+    std::span<const char> segment(int index) override;
+    std::vector<std::span<const char>> segments() override;
+    std::shared_ptr<const TextSnapshot> snapshot() override;
+
+    /* The text before and after the gap, which together make up the whole text. */
+    std::pair<std::span<const char>, std::span<const char>> spans();
+
+    /* Hands over the buffer, with the gap moved to the end and cut off so that it holds just the
+    text, and leaves the gap buffer empty. This costs the gap move, but copies nothing else. */
+    std::shared_ptr<const std::vector<char>> take_text();
+
+    char at(int index) override;
+    int size() override;
+    void clear() override;
+
+    void compact() override;
+    void debug(std::ostream &os) override;
+
+private:
+    std::vector<char> buffer;
+
+    GapPolicy policy;
+    int gap_len;
+    int gap_pos;
+
+    void move_gap(int index);
+    void grow_gap(int required_len);
+    void resize_gap(int new_gap_len);
+    int target_gap_len(int text_len);
+
+    /* There are two "positions" in a gap buffer. The "buffer space" position is the index inside the
+    raw buffer, which includes the gap. The "text space" position is the conceptual position based
+    on just the text, so without the gap. This converts from one to the other. */
+    int to_buffer_space(int text_space_pos);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/* Finds the newlines of a text on a background thread, a chunk at a time and in order, so that a
+line index can be built up as far as it's needed rather than all at once (see
+TextMetadata::rebuild_lazily()).
+
+Chunks are taken in order. A chunk the worker hasn't got to yet is scanned by the taker instead, so
+taking never waits for the worker, and the worker skips ahead past it. The worker stays at most
+MAX_CHUNKS_AHEAD chunks ahead of the taker, which bounds the memory held by scanned chunks. */
+class LineIndexer
+{
+public:
+    /* owner keeps the memory behind text alive (and unchanged) for as long as the indexer needs it. */
+    LineIndexer(std::string_view text, std::shared_ptr<const void> owner);
+
+    /* Stops the worker, and waits for it. */
+    ~LineIndexer();
+
+    LineIndexer(const LineIndexer &indexer) = delete;
+    LineIndexer &operator=(const LineIndexer &indexer) = delete;
+
+    std::size_t chunk_count() const;
+
+    /* The offset in the text of the first chunk not yet taken. */
+    std::size_t next_chunk_start();
+
+    bool finished();
+
+    /* Whether the next chunk has already been scanned by the worker, i.e. whether taking it is
+    cheap. */
+    bool ready();
+
+    /* Returns the positions of the newlines in the next chunk, relative to its start. Must not be
+    called once every chunk has been taken. */
+    std::vector<int> take();
+
+    static constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+
+private:
+    static constexpr std::size_t MAX_CHUNKS_AHEAD = 64;
+
+    std::string_view text;
+    std::shared_ptr<const void> owner;
+
+    std::mutex mutex;
+    std::condition_variable chunk_taken;
+
+    /* The chunks scanned by the worker but not yet taken, in order, starting from the one at taken. */
+    std::deque<std::vector<int>> scanned;
+    std::size_t taken = 0;
+    bool stopping = false;
+
+    std::thread thread;
+
+    void run();
+
+    /* Returns the positions of the newlines in chunk, relative to its start. */
+    std::vector<int> scan(std::size_t chunk) const;
+};
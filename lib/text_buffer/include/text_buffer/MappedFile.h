@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/* A read-only memory mapping of a whole file. Pages are only read in from disk when they're touched,
+and are shared with the page cache, so opening a file this way costs neither time nor memory
+proportional to its size. */
+class MappedFile
+{
+public:
+    /* Returns nullptr if the file can't be opened or mapped, or is larger than MAX_SIZE. */
+    static std::shared_ptr<MappedFile> open(const std::string &file_path);
+
+    /* Text positions are ints throughout (storage, line metadata, undo history), so files have to
+    be indexable with one, i.e. just under 2 GB. */
+    static constexpr std::size_t MAX_SIZE = std::numeric_limits<int>::max();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &file) = delete;
+    MappedFile &operator=(const MappedFile &file) = delete;
+
+    std::string_view text() const;
+
+private:
+    MappedFile(const char *mapped_data, std::size_t mapped_size) : data(mapped_data), size(mapped_size) {};
+
+    const char *data;
+    std::size_t size;
+};
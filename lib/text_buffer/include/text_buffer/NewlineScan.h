@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/* Implementations of the newline scanning kernel. AVX2 and SSE2 are only available on x86, and AVX2
+also has to be supported by the CPU at runtime. */
+enum class ScanKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+/* The fastest kernel supported by the CPU the program is running on. Detected once, on first use. */
+ScanKernel best_scan_kernel();
+
+bool scan_kernel_supported(ScanKernel kernel);
+
+/* Writes the index of every newline in [data, data + size) to positions, which must have room for
+size entries (i.e. the worst case, where every character is a newline). Returns the number of
+newlines found. Uses the best kernel for this CPU. */
+std::size_t find_newlines(const char *data, std::size_t size, int *positions);
+
+/* As above, but with a specific kernel (which must be supported), for benchmarking and testing. */
+std::size_t find_newlines(ScanKernel kernel, const char *data, std::size_t size, int *positions);
+
+/* Returns the index of every newline in text. Scans in fixed size chunks, so the only memory used
+beyond the result is a small scratch buffer. */
+std::vector<int> find_newlines(std::string_view text);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "SumTree.h"
+#include "TextArena.h"
+#include "TextStorage.h"
+
+enum class PieceSource
+{
+    ORIGINAL,
+    ADDED
+};
+
+/* A span of text from one of the piece table's buffers. Neither buffer ever moves its text, so
+pieces can point straight at it. */
+struct Piece
+{
+    PieceSource source;
+    const char *data;
+    int length;
+};
+
+/* Stores the text as a sequence of pieces that point into either the original (read-only) text or
+an append-only buffer of added text. The original text is never copied, and as the pieces live in
+a SumTree, edits are O(log n) in the number of pieces regardless of where they happen. */
+class PieceTable : public TextStorage
+{
+public:
+    PieceTable();
+
+    /* Uses original as the initial text without copying it. The owner (if any) is kept alive for
+    as long as the piece table needs the original text. */
+    PieceTable(std::string_view original, std::shared_ptr<const void> owner);
+
+    void insert(int index, std::string_view text) override;
+    void erase(int index, int length) override;
+
+    /* Rebuilds the piece list in a single pass, O(pieces + replacements), rather than splitting
+    pieces one replacement at a time. */
+    void replace(std::span<const Replacement> replacements) override;
+    std::string read(int index, int length) override;
+    std::span<const char> segment(int index) override;
+    std::vector<std::span<const char>> segments() override;
+    std::shared_ptr<const TextSnapshot> snapshot() override;
+    bool has_cheap_snapshots() override;
+
+    char at(int index) override;
+    int size() override;
+    void clear() override;
+
+    void debug(std::ostream &os) override;
+
+private:
+    std::string_view original;
+    std::shared_ptr<const void> original_owner;
+
+    /* Added text lives in an arena, so it never moves or changes once added, and a snapshot can
+    share the arena rather than copy it (even while more text is appended on another thread). */
+    std::shared_ptr<TextArena> added;
+
+    SumTree<Piece> pieces;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "FileWriter.h"
+#include "TextSnapshot.h"
+
+enum class SaveState
+{
+    IDLE,
+    SAVING,
+    SUCCEEDED,
+    FAILED
+};
+
+/* The state of the most recent save. */
+struct SaveStatus
+{
+    SaveState state = SaveState::IDLE;
+    std::string file_path;
+    std::size_t bytes_written = 0;
+    std::size_t bytes_total = 0;
+
+    /* The version passed to SaveWorker::save() with this save's snapshot, so that callers can tell
+    which contents it wrote, even if later saves were queued in the meantime. */
+    int version = 0;
+
+    /* Counts finished saves, so that callers polling the status can tell when a new one finishes. */
+    int finished_count = 0;
+};
+
+/* Writes snapshots to disk on a background thread, so that saving never blocks editing. */
+class SaveWorker
+{
+public:
+    SaveWorker();
+
+    /* Finishes any save in progress (so that no temporary files are left behind) before returning. */
+    ~SaveWorker();
+
+    SaveWorker(const SaveWorker &worker) = delete;
+    SaveWorker &operator=(const SaveWorker &worker) = delete;
+
+    /* Queues snapshot to be written to file_path, and returns straight away. A save that is queued
+    but not yet started is replaced, as only the newest contents are worth writing. version is
+    reported back in the status of this save. */
+    void save(std::shared_ptr<const TextSnapshot> snapshot, const std::string &file_path, SyncPolicy sync = SyncPolicy::FILE, int version = 0);
+
+    /* Blocks until every queued save has finished. */
+    void wait();
+
+    bool busy();
+    SaveStatus status();
+
+private:
+    struct Job
+    {
+        std::shared_ptr<const TextSnapshot> snapshot;
+        std::string file_path;
+        SyncPolicy sync;
+        int version;
+    };
+
+    std::mutex mutex;
+    std::condition_variable job_queued;
+    std::condition_variable job_finished;
+
+    std::optional<Job> pending;
+    bool writing = false;
+    bool stopping = false;
+
+    SaveStatus current_status;
+
+    /* Updated by the worker as it writes, without taking the lock. */
+    std::atomic<std::size_t> bytes_written = 0;
+
+    std::thread thread;
+
+    void run();
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+
+#include "TextSnapshot.h"
+
+/* Statistics of a whole text. Line lengths don't include the newline, and words are runs of
+characters other than ASCII whitespace (as counted by wc -w). */
+struct TextStats
+{
+    /* False until the first snapshot has been counted. */
+    bool counted = false;
+
+    /* The version passed to StatsWorker::update() with the snapshot these are for. */
+    int version = 0;
+
+    std::size_t line_count = 0;
+    std::size_t byte_count = 0;
+    std::size_t word_count = 0;
+    std::size_t longest_line = 0;
+};
+
+/* Counts the statistics of snapshots on a background thread, so that keeping them up to date never
+blocks editing, and publishes them without a lock, so that reading them never does either.
+
+Counting is incremental. Snapshot memory never changes while the snapshot is alive, so the counts
+of the previous snapshot's segments (and of aligned blocks within them) are kept along with it, and
+whatever the next snapshot still shares with it (usually all but the few pieces around an edit) is
+not read again. Counts are combined across segment boundaries, so a line or word split between
+pieces is still one line or word. */
+class StatsWorker
+{
+public:
+    StatsWorker();
+
+    /* Stops counting (leaving the last published stats as they are), and waits for the thread. */
+    ~StatsWorker();
+
+    StatsWorker(const StatsWorker &worker) = delete;
+    StatsWorker &operator=(const StatsWorker &worker) = delete;
+
+    /* Queues snapshot to be counted, and returns straight away. A snapshot that is queued but not
+    yet started is replaced, as only the newest is worth counting. version is published with its
+    stats, so that callers can tell which edit they're up to date with. */
+    void update(std::shared_ptr<const TextSnapshot> snapshot, int version);
+
+    /* Blocks until every queued snapshot has been counted. */
+    void wait();
+
+    bool busy();
+
+    /* Returns the latest published stats. Lock free, so cheap enough to call every frame. */
+    TextStats stats() const;
+
+    /* The counts of a run of text, which can be combined with the counts of the run after it. */
+    struct Summary
+    {
+        std::size_t bytes = 0;
+        std::size_t newlines = 0;
+        std::size_t words = 0;
+
+        /* The lengths of the text before the first newline and after the last one (both the whole
+        run if it has no newlines), and of the longest line between two of its newlines. */
+        std::size_t first_line = 0;
+        std::size_t last_line = 0;
+        std::size_t longest_inner_line = 0;
+
+        bool starts_in_word = false;
+        bool ends_in_word = false;
+    };
+
+private:
+    /* Segments are counted in aligned blocks of this many bytes where they can be, so that a large
+    piece split by an edit only has its partial blocks read again. */
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    struct SegmentKey
+    {
+        const char *data;
+        std::size_t size;
+
+        bool operator==(const SegmentKey &other) const = default;
+    };
+
+    struct SegmentKeyHash
+    {
+        std::size_t operator()(const SegmentKey &key) const;
+    };
+
+    std::mutex mutex;
+    std::condition_variable snapshot_queued;
+    std::condition_variable snapshot_counted;
+
+    std::shared_ptr<const TextSnapshot> pending;
+    int pending_version = 0;
+    bool counting = false;
+
+    /* Also read by the worker while counting, without the lock, so that it can stop part way. */
+    std::atomic<bool> stopping = false;
+
+    /* Only used by the worker. last_counted keeps alive the memory that the cached counts are keyed
+    by. */
+    std::shared_ptr<const TextSnapshot> last_counted;
+    std::unordered_map<SegmentKey, Summary, SegmentKeyHash> segment_counts;
+    std::unordered_map<const char *, Summary> block_counts;
+
+    /* The published stats, as a seqlock: sequence is odd while they're being written, and readers
+    retry if it changed while they were reading. */
+    std::atomic<unsigned> sequence = 0;
+    std::atomic<int> published_version = 0;
+    std::atomic<std::size_t> published_lines = 0;
+    std::atomic<std::size_t> published_bytes = 0;
+    std::atomic<std::size_t> published_words = 0;
+    std::atomic<std::size_t> published_longest = 0;
+
+    std::thread thread;
+
+    void run();
+
+    /* Counts snapshot, reusing the counts cached for the last one, and replacing them with its own.
+    Returns false if stopped part way. */
+    bool count(const TextSnapshot &snapshot, Summary &total);
+
+    Summary count_segment(std::span<const char> segment, std::unordered_map<SegmentKey, Summary, SegmentKeyHash> &new_segment_counts, std::unordered_map<const char *, Summary> &new_block_counts, std::size_t &bytes_read);
+
+    void publish(const Summary &total, int version);
+};
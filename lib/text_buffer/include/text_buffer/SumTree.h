@@ -0,0 +1,433 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+/* A sequence of items that each have a length, stored as an implicit treap (a randomised balanced
+binary tree that is ordered by position rather than by key). Every node tracks the item count and
+total length of its subtree, so lookups by index or by length offset, inserts, erases, and length
+updates are all O(log n).
+
+T must have an int member called length. */
+template <typename T>
+class SumTree
+{
+public:
+    SumTree()
+    {
+        /* Node 0 is the null node, so that children can be "null" without any special cases. */
+        nodes.push_back(Node{});
+    }
+
+    int size() const { return nodes[root].count; }
+    int total_length() const { return nodes[root].sum; }
+    bool empty() const { return root == 0; }
+
+    const T &at(int index) const
+    {
+        return nodes[find_node(index)].value;
+    }
+
+    /* Replaces the item at index, updating the sums of everything above it. */
+    void set(int index, const T &value)
+    {
+        int delta = value.length - at(index).length;
+        int node = descend(index, delta);
+        nodes[node].value = value;
+    }
+
+    /* Adds delta to the length of the item at index. */
+    void add_length(int index, int delta)
+    {
+        int node = descend(index, delta);
+        nodes[node].value.length += delta;
+    }
+
+    /* The total length of the items before index. */
+    int prefix_length(int index) const
+    {
+        int node = root;
+        int total = 0;
+
+        while (node != 0)
+        {
+            const Node &n = nodes[node];
+            int left_count = nodes[n.left].count;
+
+            if (index < left_count)
+            {
+                node = n.left;
+            }
+            else if (index == left_count)
+            {
+                return total + nodes[n.left].sum;
+            }
+            else
+            {
+                total += nodes[n.left].sum + n.value.length;
+                index -= left_count + 1;
+                node = n.right;
+            }
+        }
+
+        return total;
+    }
+
+    /* Finds the item that contains the length offset, returning its index and the offset relative
+    to the item's start. Zero-length items never contain an offset. Offsets beyond the end belong to
+    the final item. */
+    std::pair<int, int> find(int offset) const
+    {
+        if (empty())
+            return {-1, 0};
+
+        if (offset >= total_length())
+        {
+            int last = size() - 1;
+            return {last, offset - prefix_length(last)};
+        }
+
+        int node = root;
+        int index = 0;
+        offset = std::max(offset, 0);
+
+        while (node != 0)
+        {
+            const Node &n = nodes[node];
+            const Node &left = nodes[n.left];
+
+            if (offset < left.sum)
+            {
+                node = n.left;
+                continue;
+            }
+
+            offset -= left.sum;
+
+            if (offset < n.value.length)
+                return {index + left.count, offset};
+
+            offset -= n.value.length;
+            index += left.count + 1;
+            node = n.right;
+        }
+
+        return {size() - 1, 0}; // Unreachable while the sums are consistent
+    }
+
+    void insert(int index, const T &value)
+    {
+        int node = new_node(value);
+
+        int left, right;
+        split(root, index, left, right);
+        root = merge(merge(left, node), right);
+    }
+
+    /* Inserts all of values before index. Building the new items into a subtree first makes this
+    O(k + log n) rather than O(k log n). */
+    void insert(int index, std::span<const T> values)
+    {
+        int subtree = build(values);
+
+        int left, right;
+        split(root, index, left, right);
+        root = merge(merge(left, subtree), right);
+    }
+
+    void erase(int index)
+    {
+        erase(index, index + 1);
+    }
+
+    /* Erases the items in [first, last). */
+    void erase(int first, int last)
+    {
+        if (first >= last)
+            return;
+
+        int left, middle, right;
+        split(root, first, left, middle);
+        split(middle, last - first, middle, right);
+
+        free_subtree(middle);
+        root = merge(left, right);
+    }
+
+    /* Replaces the whole sequence with values, in O(k). */
+    void assign(std::span<const T> values)
+    {
+        clear();
+        root = build(values);
+    }
+
+    void clear()
+    {
+        nodes.resize(1);
+        free_nodes.clear();
+        root = 0;
+    }
+
+    /* Calls fn(index, prefix_length, item) for every item, in order. */
+    template <typename Fn>
+    void for_each(Fn fn) const
+    {
+        std::vector<int> stack;
+        int node = root;
+        int index = 0;
+        int offset = 0;
+
+        while (node != 0 || !stack.empty())
+        {
+            while (node != 0)
+            {
+                stack.push_back(node);
+                node = nodes[node].left;
+            }
+
+            node = stack.back();
+            stack.pop_back();
+
+            fn(index, offset, nodes[node].value);
+            index++;
+            offset += nodes[node].value.length;
+
+            node = nodes[node].right;
+        }
+    }
+
+private:
+    struct Node
+    {
+        T value{};
+        uint32_t priority = 0;
+        int left = 0;
+        int right = 0;
+        int count = 0;
+        int sum = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> free_nodes;
+    int root = 0;
+
+    uint32_t rng_state = 0x9e3779b9;
+
+    uint32_t next_priority()
+    {
+        /* xorshift32, which is plenty random enough to keep the tree balanced. */
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        return rng_state;
+    }
+
+    int new_node(const T &value)
+    {
+        Node node;
+        node.value = value;
+        node.priority = next_priority();
+        node.count = 1;
+        node.sum = value.length;
+
+        if (!free_nodes.empty())
+        {
+            int index = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[index] = node;
+            return index;
+        }
+
+        nodes.push_back(node);
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    void free_subtree(int node)
+    {
+        std::vector<int> stack;
+
+        if (node != 0)
+            stack.push_back(node);
+
+        while (!stack.empty())
+        {
+            int current = stack.back();
+            stack.pop_back();
+
+            if (nodes[current].left != 0)
+                stack.push_back(nodes[current].left);
+            if (nodes[current].right != 0)
+                stack.push_back(nodes[current].right);
+
+            free_nodes.push_back(current);
+        }
+    }
+
+    void pull(int node)
+    {
+        Node &n = nodes[node];
+        n.count = nodes[n.left].count + nodes[n.right].count + 1;
+        n.sum = nodes[n.left].sum + nodes[n.right].sum + n.value.length;
+    }
+
+    int find_node(int index) const
+    {
+        int node = root;
+
+        while (node != 0)
+        {
+            int left_count = nodes[nodes[node].left].count;
+
+            if (index < left_count)
+            {
+                node = nodes[node].left;
+            }
+            else if (index == left_count)
+            {
+                return node;
+            }
+            else
+            {
+                index -= left_count + 1;
+                node = nodes[node].right;
+            }
+        }
+
+        return 0;
+    }
+
+    /* Walks down to the node at index, adding delta to the sum of every node on the way. */
+    int descend(int index, int delta)
+    {
+        if (index < 0 || index >= size())
+            return 0;
+
+        int node = root;
+
+        while (true)
+        {
+            Node &n = nodes[node];
+            int left_count = nodes[n.left].count;
+
+            n.sum += delta;
+
+            if (index < left_count)
+            {
+                node = n.left;
+            }
+            else if (index == left_count)
+            {
+                return node;
+            }
+            else
+            {
+                index -= left_count + 1;
+                node = n.right;
+            }
+        }
+    }
+
+    /* Splits the subtree at node so that the first count items end up in left. */
+    void split(int node, int count, int &left, int &right)
+    {
+        if (node == 0)
+        {
+            left = right = 0;
+            return;
+        }
+
+        Node &n = nodes[node];
+        int left_count = nodes[n.left].count;
+
+        if (count <= left_count)
+        {
+            split(n.left, count, left, n.left);
+            right = node;
+        }
+        else
+        {
+            split(n.right, count - left_count - 1, n.right, right);
+            left = node;
+        }
+
+        pull(node);
+    }
+
+    int merge(int left, int right)
+    {
+        if (left == 0 || right == 0)
+            return left != 0 ? left : right;
+
+        if (nodes[left].priority > nodes[right].priority)
+        {
+            nodes[left].right = merge(nodes[left].right, right);
+            pull(left);
+            return left;
+        }
+
+        nodes[right].left = merge(left, nodes[right].left);
+        pull(right);
+        return right;
+    }
+
+    /* Builds a treap out of values in O(k), using the standard stack-based Cartesian tree
+    construction, then fills in the counts and sums bottom-up. */
+    int build(std::span<const T> values)
+    {
+        /* Grown geometrically, as an exact reserve would reallocate every node on each of a run of
+        inserts (e.g. as lines are indexed a chunk at a time). */
+        std::size_t needed = nodes.size() + values.size();
+
+        if (needed > nodes.capacity())
+            nodes.reserve(std::max(needed, nodes.capacity() * 2));
+
+        std::vector<int> right_spine;
+
+        for (const T &value : values)
+        {
+            int node = new_node(value);
+            int last_popped = 0;
+
+            while (!right_spine.empty() && nodes[right_spine.back()].priority < nodes[node].priority)
+            {
+                last_popped = right_spine.back();
+                right_spine.pop_back();
+            }
+
+            nodes[node].left = last_popped;
+
+            if (!right_spine.empty())
+                nodes[right_spine.back()].right = node;
+
+            right_spine.push_back(node);
+        }
+
+        if (right_spine.empty())
+            return 0;
+
+        /* Children always come after their parent in a pre-order walk, so pulling in reverse
+        pre-order computes every child before its parent. */
+        std::vector<int> order;
+        std::vector<int> stack = {right_spine.front()};
+
+        while (!stack.empty())
+        {
+            int node = stack.back();
+            stack.pop_back();
+            order.push_back(node);
+
+            if (nodes[node].left != 0)
+                stack.push_back(nodes[node].left);
+            if (nodes[node].right != 0)
+                stack.push_back(nodes[node].right);
+        }
+
+        for (auto itr = order.rbegin(); itr != order.rend(); itr++)
+            pull(*itr);
+
+        return right_spine.front();
+    }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string_view>
+
+/* An append-only store of text, kept in large blocks that are never moved or reallocated. Text is
+copied in once, and from then on the view returned by append() stays valid and unchanged for as
+long as the arena (or, for release_front(), the block) does, so it can be pointed to directly,
+including from other threads.
+
+Appending only allocates when the current block is full, so e.g. typing costs no allocations at all
+most of the time, and as the blocks are all freed together (or oldest first), long sessions don't
+fragment the heap. */
+class TextArena
+{
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit TextArena(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    TextArena(const TextArena &arena) = delete;
+    TextArena &operator=(const TextArena &arena) = delete;
+
+    /* Copies text into the arena and returns where it now lives. The text is always contiguous, so
+    if it doesn't fit in what's left of the current block, a new block is started (one just big
+    enough, if the text is bigger than a block). Appends that fit directly follow the previous one,
+    so callers can tell whether two appends are adjacent by comparing their views. */
+    std::string_view append(std::string_view text);
+
+    /* Frees every block older than the one holding data, for callers that drop their oldest text
+    first (e.g. a history with a memory limit). Nothing before data may be used afterwards. */
+    void release_front(const char *data);
+
+    void clear();
+
+    /* Bytes allocated for blocks, including any space not yet used. */
+    std::size_t memory_usage() const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        std::size_t capacity;
+    };
+
+    std::size_t block_size;
+
+    /* Oldest first, so the last block is the one being appended to. */
+    std::deque<Block> blocks;
+    std::size_t last_block_used = 0;
+
+    std::size_t allocated = 0;
+};
@@ -1,51 +1,229 @@
 #pragma once
 
+#include <limits>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "FileWriter.h"
+#include "GapBuffer.h"
+#include "PieceTable.h"
 #include "TextMetadata.h"
+#include "TextView.h"
+#include "UndoHistory.h"
+
+/* Which TextStorage implementation a TextBuffer uses. */
+enum class StorageKind
+{
+    GAP_BUFFER,
+    PIECE_TABLE
+};
+
+/* The lines changed by edits, from first_line to last_line inclusive. Edits that add or remove
+lines damage everything after them too, as those lines have all moved. */
+struct LineDamage
+{
+    int first_line = std::numeric_limits<int>::max();
+    int last_line = -1;
+
+    bool empty() const { return first_line > last_line; }
+};
+
+class TextBuffer;
+
+/* The lines [first_line, last_line) of a TextBuffer, iterated as views of their text (without the
+newlines). Like TextView, this is only valid until the next edit. */
+class LineRange
+{
+public:
+    class Iterator
+    {
+    public:
+        Iterator(TextBuffer *buffer, int line_num) : buffer(buffer), line_num(line_num) {};
+
+        TextView operator*() const;
+        Iterator &operator++()
+        {
+            line_num++;
+            return *this;
+        }
+        bool operator!=(const Iterator &other) const { return line_num != other.line_num; }
+
+    private:
+        TextBuffer *buffer;
+        int line_num;
+    };
+
+    LineRange(TextBuffer *buffer, int first_line, int last_line) : buffer(buffer), first_line(first_line), last_line(last_line) {};
+
+    Iterator begin() const { return Iterator(buffer, first_line); }
+    Iterator end() const { return Iterator(buffer, last_line); }
+
+private:
+    TextBuffer *buffer;
+    int first_line;
+    int last_line;
+};
 
 class TextBuffer
 {
 public:
     TextBuffer();
+    explicit TextBuffer(StorageKind storage_kind);
+    explicit TextBuffer(GapPolicy gap_policy);
+
+    /* Replaces the contents with the file at file_path, which is memory-mapped and used directly
+    as the original text of a piece table, rather than copied in. Its lines are indexed lazily (see
+    TextMetadata::rebuild_lazily()), so opening costs the same however large the file is. Returns
+    false (leaving the contents untouched) if the file can't be mapped, or is larger than
+    MappedFile::MAX_SIZE. */
+    bool open(const std::string &file_path);
+
+    /* Saves the contents to file_path without copying them (see write_file()). Returns false if the
+    file couldn't be written, in which case any existing file is left as it was. */
+    bool save(const std::string &file_path, SyncPolicy sync = SyncPolicy::FILE);
+
+    /* Captures the contents so that they can be saved in the background (see SaveWorker). This is
+    O(pieces) for a piece table, but has to copy the text of a gap buffer. */
+    std::shared_ptr<const TextSnapshot> snapshot();
+
+    /* Whether snapshot() is O(pieces), i.e. cheap enough to take after every edit, rather than a
+    copy of the text. */
+    bool has_cheap_snapshots();
+
+    /* Switches a gap buffer over to a piece table whose original text is the gap buffer's own
+    memory (see GapBuffer::take_text()), so that snapshots are cheap from then on, without copying
+    the text. Does nothing if the storage is already a piece table. */
+    void use_piece_table();
 
     void set_cursor_pos(int row, int col);
 
+    /* Adds another cursor at (row, col), clamped in the same way as set_cursor_pos(). While there
+    are extra cursors, insert() and pop() edit at every cursor at once, as a single batched edit
+    (see replace()), so typing at K cursors costs one pass over the storage rather than K separate
+    edits. Other edits move the extra cursors along with the text, except for undo, redo and
+    clear(), which remove them. */
+    void add_cursor(int row, int col);
+
+    /* Removes every cursor except the main one. */
+    void clear_extra_cursors();
+
+    /* The text space offsets of the extra cursors (not including the main one), in order. */
+    const std::vector<int> &get_extra_cursors();
+
     void insert(char c);
     void pop();
+
+    /* Inserts text at the cursor, leaving the cursor after it. This is a single storage edit and a
+    single line metadata update, however long the text is (e.g. for pastes). */
+    void insert(std::string_view text);
+
+    /* Erases the text space range [start, end). A cursor inside the range ends up at start. */
+    void erase(int start, int end);
+
+    /* Makes all of the replacements (sorted by index, and not overlapping) as one edit: a single
+    pass over the storage and a single rebuild of the line metadata, so it costs O(n) however many
+    replacements there are. Undo reverts them all at once. A cursor inside a replaced range ends up
+    at its start. */
+    void replace(std::span<const Replacement> replacements);
+
     void clear();
 
-    std::string get_text();
+    /* Reverts the last edit (a run of typing counts as one), or reapplies the last one undone,
+    moving the cursor to where the edit was. Both cost O(edit size). Return false if there was
+    nothing to undo or redo. */
+    bool undo();
+    bool redo();
+
+    /* Releases excess storage memory (e.g. after a large delete). Intended to be called when idle. */
+    void compact();
+
+    /* Returns a view of the whole text. This doesn't copy anything (see TextView). */
+    TextView get_text();
+
+    /* Returns a view of up to max_len characters of the line at line_num (without its newline),
+    starting from column start_col. Costs O(log n), however long the line or document is. */
+    TextView get_line(int line_num, int start_col = 0, int max_len = std::numeric_limits<int>::max());
+
+    /* Returns the lines [first_line, last_line), clamped to the lines that exist. */
+    LineRange lines(int first_line, int last_line);
     bool is_empty();
+    int get_cursor_row();
+    int get_cursor_col();
+
+    /* While the line index is incomplete, this is only the lines indexed so far, plus one for the
+    unindexed rest of the text. */
     int get_line_count();
+
+    /* The line index of an opened file is built up in the background. Until it's complete, lines
+    are indexed on demand as far as they're asked for, e.g. by index_to_line() for the lines about
+    to be displayed. poll_line_index() adds what the background thread has found so far, returning
+    whether there was anything. */
+    bool is_line_index_complete();
+    void index_to_line(int line_num);
+    bool poll_line_index();
+
     int get_line_length(int line_num);
     bool is_final_line(int line_num);
 
-private:
-    std::vector<char> buffer;
-    int buffer_len;
+    /* Returns the line containing the text space offset, in O(log n) (see
+    TextMetadata::line_of_offset()). Offsets are clamped to the text, so anything beyond the end
+    belongs to the final line. */
+    int get_line_of_offset(int offset);
 
-    const int GAP_SIZE = 5;
-    int gap_len;
-    int gap_pos;
+    /* Returns the text space offset of the start of the line at line_num. */
+    int get_line_start(int line_num);
 
-    int buffer_space_cursor_pos;
+    /* Returns the lines damaged since the last call, so that displays can redraw only those. */
+    LineDamage take_damage();
+
+    /* Writes the cursor, the storage layout, and the line metadata. This is O(n), so is only for
+    dumping state on demand, not for tracing individual operations. */
+    void dump(std::ostream &os);
+
+private:
+    std::unique_ptr<TextStorage> storage;
+
+    /* The cursor is a text space index, i.e. a position in the text itself. */
+    int cursor_pos;
     int current_line;
 
+    /* Sorted, and never at the same place as each other or the main cursor. */
+    std::vector<int> extra_cursors;
+
+    /* A line length update costs about as much as rebuilding this many lines. */
+    static constexpr std::size_t LINE_UPDATES_PER_REBUILD = 8;
+
     TextMetadata metadata = TextMetadata();
 
-    void move_gap();
-    bool gap_at_end();
+    LineDamage damage;
+
+    UndoHistory history;
+
+    void add_damage(int first_line, int last_line);
+
+    /* Edit the storage and metadata, without touching the cursor or the history. */
+    void apply_insert(int position, std::string_view text);
+    void apply_erase(int start, int end);
+    void apply_replace(std::span<const Replacement> replacements);
+
+    void move_cursor_to(int position);
+
+    /* Returns the text space index of (row, col), clamped to the text. */
+    int clamp_position(int row, int col);
+
+    /* Replaces the erase_len characters before every cursor with text, leaving each cursor after
+    its new text. Cursors closer together than erase_len only erase back to the previous one. */
+    void edit_at_cursors(std::string_view text, int erase_len);
 
-    /* There are two "positions" the cursor has. The "buffer space" position is the index of the
-    cursor inside the raw buffer, which includes the gap and any implementation-specific details.
-    The "text space" is the conceptual position of the cursor based on just the text, so without
-    the gap or any implementation details. These functions convert from one to the other. */
-    int to_buffer_space(int text_space_pos);
-    int to_text_space(int buffer_space_pos);
+    /* Moves the sorted text space positions to where their text is after replacements. Positions
+    inside a replaced range end up at its start, and inserts at a position push it along (as when
+    typing at a cursor). */
+    static void map_positions(std::vector<int> &positions, std::span<const Replacement> replacements);
 
-    void debug();
+    /* Sorts and deduplicates the extra cursors, and drops any at the main cursor. */
+    void normalise_cursors();
 };
 
 // TODO:
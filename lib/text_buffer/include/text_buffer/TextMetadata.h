@@ -2,12 +2,17 @@
 
 #include <vector>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "LineIndexer.h"
+#include "SumTree.h"
 
 struct LineMetadata
 {
-    int start_index;
     int length;
-    bool final_line;
 };
 
 class TextMetadata
@@ -24,24 +29,90 @@ public:
     line_num is empty, it effectively just "deletes" the line at line_num. */
     void merge_line(int line_num);
 
-    /* Updates the length of the line at line_num by delta. */
+    /* Updates the length of the line at line_num by delta. The start indexes of the following lines
+    are derived from the line lengths, so they don't need updating separately. */
     void update_line_length(int line_num, int delta);
 
-    /* Updates the start indexes of all of the lines from start_line_num by delta. Used to keep
-    start indexes consistent when adding or removing lines. */
-    void update_indexes(int start_line_num, int delta);
+    /* Updates the lines for text inserted at the text space index. However many lines the text
+    contains, this is a single batched update of O(k + log n) for k new lines. */
+    void insert_text(int index, std::string_view text);
+
+    /* Updates the lines for the text in [start, end) being erased, merging the lines either side of
+    the erased text. O(log n) plus the number of lines removed. */
+    void erase_text(int start, int end);
 
     void clear();
 
+    /* Replaces all of the line metadata with the lines in text, in a single pass. Used when loading
+    a whole document at once, rather than building the lines up one edit at a time. */
+    void rebuild(std::string_view text);
+
+    /* As above, for text made up of segments (see TextStorage::segments()). Used after batched
+    edits (e.g. replace-all), where one O(n) rebuild is far cheaper than updating the lines once per
+    edit. */
+    void rebuild(std::span<const std::span<const char>> segments);
+
+    /* As rebuild(text), but returns straight away however large text is. Lines are only indexed as
+    far as they're asked for (by index_to_line(), and by the getters and edits below, which index
+    as far as they reach), while the rest are found on a background thread (see LineIndexer) and
+    added by poll_index(). Until then, everything after the last line indexed is held as one final
+    line. Edits always index past themselves first, so that line is only ever the untouched rest of
+    text, which owner has to keep alive and unchanged (as a mapped file does). */
+    void rebuild_lazily(std::string_view text, std::shared_ptr<const void> owner);
+
+    /* Whether every line has been indexed. Until then, line_count() is only the lines indexed so
+    far. */
+    bool is_complete();
+
+    /* Makes sure the lines up to and including line_num are indexed (or that there are fewer lines
+    than that). Costs O(distance) if the background thread hasn't got that far yet. */
+    void index_to_line(int line_num);
+
+    /* Adds the lines the background thread has found since the last call (a bounded amount per
+    call, so that it never takes long). Returns whether any were added. */
+    bool poll_index();
+
+    /* Returns the first line that indexing has changed since the last call (as lines found are
+    split off the unindexed rest), or INT_MAX if there isn't one. */
+    int take_indexed_from();
+
     /* Getters. */
     int line_start_index(int line_num);
     int line_length(int line_num);
     int line_count();
     bool line_is_final(int line_num);
 
-    friend std::ostream &operator<<(std::ostream &os, TextMetadata tm);
+    /* Returns the line containing the text space index. Indexes at or beyond the end of the text
+    belong to the final line. */
+    int line_of_offset(int index);
+
+    friend std::ostream &operator<<(std::ostream &os, const TextMetadata &tm);
 
 private:
-    // TODO: look into using a fenwick tree for this
-    std::vector<LineMetadata> line_data;
+    /* Line lengths (including the newline) in a balanced tree, so a line's start index is the sum
+    of the lengths before it. All operations are O(log n) in the number of lines. */
+    SumTree<LineMetadata> line_data;
+
+    /* Set while lines are still being indexed lazily (see rebuild_lazily()). */
+    std::unique_ptr<LineIndexer> indexer;
+
+    /* Where the unindexed rest (i.e. the final line) starts, as an offset into the lazily indexed
+    text. This differs from its text space index once there have been edits before it. */
+    int unindexed_start = 0;
+
+    int indexed_from = std::numeric_limits<int>::max();
+
+    /* Chunks added per poll_index(). Each takes well under a millisecond. */
+    static constexpr int CHUNKS_PER_POLL = 8;
+
+    /* Makes sure the final line starts after the text space index, so that edits at or before it
+    never touch the unindexed rest. */
+    void index_to_offset(int index);
+
+    /* Adds the lines in the next chunk of the lazily indexed text. */
+    void index_chunk();
+
+    /* Appends the lines ended by newlines in segment, which starts at the text space index
+    segment_start. line_start is the start of the line in progress, and is updated as lines end. */
+    void scan_lines(std::span<const char> segment, int segment_start, int &line_start, std::vector<LineMetadata> &lines, std::vector<int> &newlines);
 };
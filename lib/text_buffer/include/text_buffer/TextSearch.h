@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "TextSnapshot.h"
+#include "ThreadPool.h"
+
+enum class SearchMode
+{
+    LITERAL,
+
+    /* ECMAScript regular expressions, matched a line at a time (so matches never span lines). */
+    REGEX
+};
+
+struct SearchMatch
+{
+    std::size_t offset;
+    std::size_t length;
+};
+
+/* The state of the current search. */
+struct SearchStatus
+{
+    bool searching = false;
+    std::size_t bytes_scanned = 0;
+    std::size_t bytes_total = 0;
+    std::size_t match_count = 0;
+
+    /* Only matches starting before this offset are kept, which is the end of the text unless more
+    than TextSearch::MAX_MATCHES were found. The matches kept are always the first ones in the text,
+    so it can move back as earlier chunks finish, and matches already taken from at or after it
+    should then be dropped. */
+    std::size_t kept_until = 0;
+
+    /* The first match at or after the offset the search started from (wrapping around to the start
+    of the text). Only set once it's certain, i.e. once everything between the start offset and the
+    match has been searched, but that's usually long before the whole search finishes. */
+    std::optional<SearchMatch> first_match;
+};
+
+/* Searches snapshots of a text on a pool of threads, so that searching never blocks editing.
+
+The text is split into chunks, which are scanned in parallel. Literal searches use memchr() (which
+is vectorised) to skip to each occurrence of the pattern's first byte, and only compare the rest of
+the pattern there. Chunks are handed out in order starting from the start offset, so the nearest
+matches are found first, and matches are streamed back through take_matches() as each chunk
+finishes rather than all at the end.
+
+Matches are byte offsets into the snapshot. Every occurrence is reported, including overlapping
+ones (e.g. "aa" matches "aaa" twice). */
+class TextSearch
+{
+public:
+    /* Zero uses one thread per hardware thread. */
+    explicit TextSearch(int thread_count = 0);
+
+    /* Cancels the search in progress, and waits for its threads. */
+    ~TextSearch();
+
+    TextSearch(const TextSearch &search) = delete;
+    TextSearch &operator=(const TextSearch &search) = delete;
+
+    /* Starts searching snapshot for pattern, from start_offset, cancelling any search still in
+    progress (along with its unclaimed matches). Returns false without searching if pattern is
+    empty or an invalid regex. */
+    bool start(std::shared_ptr<const TextSnapshot> snapshot, const std::string &pattern, SearchMode mode, std::size_t start_offset = 0);
+
+    void cancel();
+
+    /* Blocks until the current search has finished. */
+    void wait();
+
+    /* Returns the matches found since the last call, in no particular order (each chunk's matches
+    are in order, but chunks finish in any order). At most MAX_MATCHES are kept per search (the ones
+    before SearchStatus::kept_until), though all of them are counted. */
+    std::vector<SearchMatch> take_matches();
+
+    SearchStatus status();
+
+    static constexpr std::size_t MAX_MATCHES = 1 << 20;
+
+private:
+    struct Search;
+
+    /* Bytes scanned per chunk. Big enough that handing out chunks costs nothing next to scanning
+    them, small enough that the first one (and so the first match) is done within a millisecond. */
+    static constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+
+    std::mutex mutex;
+    std::condition_variable search_finished;
+
+    std::shared_ptr<Search> current;
+
+    ThreadPool pool;
+
+    /* Claims chunks of search until there are none left. Run on each of the pool's threads. */
+    void scan(const std::shared_ptr<Search> &search);
+
+    /* Records that chunk has been scanned, with its matches. */
+    void finish_chunk(Search &search, std::size_t chunk, std::vector<SearchMatch> &matches);
+
+    /* Keeps chunk's matches, dropping the last ones in the text if there are now more than
+    MAX_MATCHES. */
+    void keep_matches(Search &search, std::size_t chunk, const std::vector<SearchMatch> &matches);
+};
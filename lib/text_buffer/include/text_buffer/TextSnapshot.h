@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+/* The contents of a TextStorage at one point in time. Unlike a TextView, a snapshot stays valid
+however the storage is edited afterwards (it keeps alive whatever memory its segments point into),
+and as it is immutable it can be read from another thread, e.g. to save in the background. */
+class TextSnapshot
+{
+public:
+    TextSnapshot(std::vector<std::span<const char>> segments, std::vector<std::shared_ptr<const void>> owners)
+        : segments(std::move(segments)), owners(std::move(owners))
+    {
+        for (std::span<const char> segment : this->segments)
+            length += segment.size();
+    }
+
+    std::size_t size() const { return length; }
+
+    /* Calls fn(std::span<const char>) for each contiguous segment of the text, in order. */
+    template <typename Fn>
+    void for_each_segment(Fn fn) const
+    {
+        for (std::span<const char> segment : segments)
+            fn(segment);
+    }
+
+private:
+    std::vector<std::span<const char>> segments;
+    std::vector<std::shared_ptr<const void>> owners;
+    std::size_t length = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TextSnapshot.h"
+
+/* Replaces the length characters starting at index with text. */
+struct Replacement
+{
+    int index;
+    int length;
+    std::string_view text;
+};
+
+/* The raw character storage behind a TextBuffer. Implementations only deal with text space indexes
+(i.e. positions in the text itself), and know nothing about lines or cursors. */
+class TextStorage
+{
+public:
+    virtual ~TextStorage() = default;
+
+    /* Inserts text so that its first character ends up at index. */
+    virtual void insert(int index, std::string_view text) = 0;
+
+    /* Erases length characters, starting at index. */
+    virtual void erase(int index, int length) = 0;
+
+    /* Makes all of the replacements at once, in a single pass over the text, rather than as an
+    erase and an insert each. Indexes are all in the text before any of the replacements, and the
+    replacements must be sorted by index and not overlap. */
+    virtual void replace(std::span<const Replacement> replacements) = 0;
+
+    /* Copies the length characters starting at index. */
+    virtual std::string read(int index, int length) = 0;
+
+    /* Returns the characters from index up to the end of the contiguous run that contains it (e.g.
+    up to the gap, or the end of a piece), without copying. Only valid until the next edit. */
+    virtual std::span<const char> segment(int index) = 0;
+
+    /* Returns every contiguous run of the text, in order, without copying. Walking the whole text
+    this way is O(runs), rather than a lookup per run as with segment(). Only valid until the next
+    edit. */
+    virtual std::vector<std::span<const char>> segments() = 0;
+
+    /* Captures the current contents, so that they can be read while editing carries on. */
+    virtual std::shared_ptr<const TextSnapshot> snapshot() = 0;
+
+    /* Whether snapshot() only copies the layout of the text (O(pieces)) rather than the text itself,
+    so is cheap enough to take after every edit. */
+    virtual bool has_cheap_snapshots() { return false; };
+
+    virtual char at(int index) = 0;
+    virtual int size() = 0;
+    virtual void clear() = 0;
+
+    /* Releases any memory held for future edits. Called when the editor is idle. */
+    virtual void compact() {};
+
+    /* Writes the internal layout of the storage, for debugging. */
+    virtual void debug(std::ostream &os) = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "TextStorage.h"
+
+/* A non-owning view of a range of text in a TextStorage. The text isn't necessarily contiguous (e.g.
+it may straddle the gap of a gap buffer, or several pieces of a piece table), so it is read as a
+sequence of contiguous segments. Nothing is copied unless asked for, but the view is only valid
+until the next edit. */
+class TextView
+{
+public:
+    TextView() = default;
+    TextView(TextStorage *storage, int start, int length);
+
+    int size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    char at(int index) const;
+
+    /* Returns the view of up to sub_length characters, starting at sub_start within this view. */
+    TextView substr(int sub_start, int sub_length) const;
+
+    /* Calls fn(std::span<const char>) for each contiguous segment of the text, in order. */
+    template <typename Fn>
+    void for_each_segment(Fn fn) const
+    {
+        int pos = start;
+        int remaining = length;
+
+        while (remaining > 0)
+        {
+            std::span<const char> segment = storage->segment(pos);
+
+            if (segment.empty())
+                return;
+
+            if (static_cast<int>(segment.size()) > remaining)
+                segment = segment.first(remaining);
+
+            fn(segment);
+
+            pos += static_cast<int>(segment.size());
+            remaining -= static_cast<int>(segment.size());
+        }
+    }
+
+    /* Replaces the contents of out with the text. This reuses out's memory, so copying into the same
+    string repeatedly doesn't allocate once it is large enough. */
+    void copy_to(std::string &out) const;
+
+    std::string to_string() const;
+
+    bool operator==(std::string_view text) const;
+
+private:
+    TextStorage *storage = nullptr;
+    int start = 0;
+    int length = 0;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A fixed set of worker threads that run tasks in the order they were submitted. */
+class ThreadPool
+{
+public:
+    /* Zero starts one thread per hardware thread. */
+    explicit ThreadPool(int thread_count = 0);
+
+    /* Waits for the tasks that are running to finish. Tasks that haven't started yet are dropped,
+    so long running tasks should be cancellable some other way. */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &pool) = delete;
+    ThreadPool &operator=(const ThreadPool &pool) = delete;
+
+    void submit(std::function<void()> task);
+
+    int size() const;
+
+private:
+    std::mutex mutex;
+    std::condition_variable task_queued;
+
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+
+    std::vector<std::thread> threads;
+
+    void run();
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "TextArena.h"
+#include "TextStorage.h"
+
+enum class EditKind
+{
+    INSERT,
+    ERASE,
+
+    /* A batch of replacements made at once (e.g. replace-all), undone and redone as one. */
+    REPLACE
+};
+
+/* One of the replacements in a REPLACE edit. */
+struct ReplacedText
+{
+    /* In the text before the edit. */
+    int position;
+
+    std::string before;
+    std::string after;
+};
+
+/* A single undoable edit, with its text copied out of the history. */
+struct UndoEdit
+{
+    EditKind kind;
+    int position;
+    std::string text;
+
+    /* Where the cursor was before the edit, so that undoing it can put the cursor back. */
+    int cursor_before;
+
+    /* The replacements of a REPLACE edit, in order. Its position is that of the first one, and it
+    has no text of its own. */
+    std::vector<ReplacedText> replacements = {};
+};
+
+/* The edits made to a text, for undo and redo. Rather than snapshots, this is a log of operations,
+with the text they inserted or erased appended to an arena, so each edit costs O(edit size) to
+record and to undo or redo, and nothing else is copied.
+
+Typing coalesces: single character inserts that carry on from the previous one extend it into a run
+(up to a newline), as do consecutive backspaces or deletes, so that undo steps are runs of typing
+rather than characters, and a run costs its text plus a single record.
+
+Memory is bounded by memory_limit. Once the log outgrows it, the oldest edits are forgotten (and
+the arena blocks holding their text freed). */
+class UndoHistory
+{
+public:
+    static constexpr std::size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+    explicit UndoHistory(std::size_t memory_limit = DEFAULT_MEMORY_LIMIT);
+
+    /* Record an edit that has just been made. Any undone edits can no longer be redone. */
+    void record_insert(int position, std::string_view text, int cursor_before);
+    void record_erase(int position, std::string_view text, int cursor_before);
+
+    /* Record a batch of replacements that has just been made, where replaced is the text they
+    replaced, one after another. It's recorded as a single edit, and never coalesces. */
+    void record_replace(std::span<const Replacement> replacements, std::string_view replaced, int cursor_before);
+
+    /* Stops the next edit from coalescing with the last one (e.g. because the cursor moved). */
+    void seal();
+
+    /* Returns the last edit that hasn't been undone and marks it as undone, for the caller to
+    revert. Returns nullopt if there's nothing to undo. */
+    std::optional<UndoEdit> undo();
+
+    /* Returns the last undone edit and marks it as done again, for the caller to reapply. */
+    std::optional<UndoEdit> redo();
+
+    bool can_undo() const;
+    bool can_redo() const;
+
+    /* Whether an edit of length bytes could be recorded at all. Larger edits clear the history
+    instead, so callers can check this before copying out the text of a huge erase. */
+    bool fits(std::size_t length) const;
+
+    void clear();
+
+    /* Bytes used by the log, counting both text and records. */
+    std::size_t memory_usage() const;
+
+private:
+    struct ReplacedSpan
+    {
+        int position;
+        int before_length;
+        int after_length;
+    };
+
+    struct Record
+    {
+        EditKind kind;
+        int position;
+        int length;
+        int cursor_before;
+
+        /* Where the text is in the arena. */
+        const char *text;
+
+        /* Backspace runs log each erased character after the one before it, which is the reverse of
+        the order they appear in the text. */
+        bool reversed;
+
+        /* For REPLACE records, where each replacement was and how long its text was before and
+        after. The text is all of the before text, followed by all of the after text. */
+        std::vector<ReplacedSpan> spans = {};
+    };
+
+    std::size_t memory_limit;
+
+    std::deque<Record> records;
+
+    /* How many of the records are done (the rest have been undone, and can be redone). */
+    std::size_t done_count = 0;
+
+    /* Text is appended in the same order as the records, so the oldest records' text is always in
+    the oldest blocks. Undone records' text is simply left behind when they're discarded, and freed
+    along with the blocks around it. */
+    TextArena arena;
+
+    /* Memory held by the REPLACE records' spans, which is counted towards the limit. */
+    std::size_t span_memory = 0;
+
+    /* Set by seal(), and cleared by the next edit. */
+    bool sealed = true;
+
+    /* Drops the undone records, which always sit at the end. */
+    void discard_redo();
+
+    /* Forgets the oldest records until the log fits in memory_limit. */
+    void enforce_limit();
+
+    /* Extends the last record with stored (text already in the arena), if it's straight after the
+    record's own text. It isn't if the arena had to start a new block, in which case the run ends. */
+    bool extend(std::string_view stored);
+
+    void push(EditKind kind, int position, std::string_view stored, int cursor_before, std::vector<ReplacedSpan> spans = {});
+    std::string text_of(const Record &record) const;
+    UndoEdit to_edit(const Record &record) const;
+};
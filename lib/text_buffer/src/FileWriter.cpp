@@ -0,0 +1,176 @@
+#include "text_buffer/FileWriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    /* The most buffers a single writev() accepts. A gap buffer only ever needs two, but a heavily
+    edited piece table can have far more segments than this, so they are written in batches. */
+#ifdef IOV_MAX
+    constexpr int MAX_IOVECS = IOV_MAX;
+#else
+    constexpr int MAX_IOVECS = 1024;
+#endif
+
+    /* Distinguishes the temporary files of saves running at the same time in the same process. */
+    std::atomic<unsigned int> temp_counter = 0;
+
+    /* Writes all of the count buffers in iov, retrying after short writes and interruptions. */
+    bool write_all(int fd, iovec *iov, int count)
+    {
+        while (count > 0)
+        {
+            ssize_t written = writev(fd, iov, count);
+
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            /* Skip the buffers that were written completely, then trim the one written partially. */
+            while (count > 0 && static_cast<std::size_t>(written) >= iov->iov_len)
+            {
+                written -= static_cast<ssize_t>(iov->iov_len);
+                iov++;
+                count--;
+            }
+
+            if (count > 0)
+            {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+                iov->iov_len -= static_cast<std::size_t>(written);
+            }
+        }
+
+        return true;
+    }
+
+    /* How much is written between progress reports. Larger segments are split up to keep to it. */
+    constexpr std::size_t WRITE_BATCH_SIZE = 8 * 1024 * 1024;
+
+    template <typename Text>
+    bool write_segments(int fd, const Text &text, const WriteProgress &progress)
+    {
+        iovec iov[MAX_IOVECS];
+        int count = 0;
+        std::size_t batch_size = 0;
+        std::size_t total_written = 0;
+        bool ok = true;
+
+        auto flush = [&]()
+        {
+            ok = ok && write_all(fd, iov, count);
+            total_written += batch_size;
+
+            count = 0;
+            batch_size = 0;
+
+            if (ok && progress)
+                progress(total_written);
+        };
+
+        text.for_each_segment([&](std::span<const char> segment)
+                              {
+                                  while (ok && !segment.empty())
+                                  {
+                                      std::span<const char> part = segment.first(std::min(segment.size(), WRITE_BATCH_SIZE - batch_size));
+                                      segment = segment.subspan(part.size());
+
+                                      iov[count].iov_base = const_cast<char *>(part.data());
+                                      iov[count].iov_len = part.size();
+                                      count++;
+                                      batch_size += part.size();
+
+                                      if (count == MAX_IOVECS || batch_size == WRITE_BATCH_SIZE)
+                                          flush();
+                                  } });
+
+        if (count > 0)
+            flush();
+
+        return ok;
+    }
+
+    bool sync_directory(const std::string &file_path)
+    {
+        std::string::size_type slash = file_path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : file_path.substr(0, std::max<std::string::size_type>(slash, 1));
+
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+
+        if (fd < 0)
+            return false;
+
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }
+
+    template <typename Text>
+    bool write_text(const std::string &file_path, const Text &text, SyncPolicy sync, const WriteProgress &progress)
+    {
+        std::string temp_path;
+        int fd = -1;
+
+        /* The temporary file has to be in the same directory (so on the same filesystem) as
+        file_path, or the rename couldn't be atomic. */
+        for (int attempt = 0; attempt < 16 && fd < 0; attempt++)
+        {
+            temp_path = file_path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(temp_counter++);
+            fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+
+            if (fd < 0 && errno != EEXIST)
+                return false;
+        }
+
+        if (fd < 0)
+            return false;
+
+        /* Keep the permissions of the file being replaced. New files just get the usual umask. */
+        struct stat existing;
+
+        bool ok = true;
+
+        if (stat(file_path.c_str(), &existing) == 0)
+            ok = fchmod(fd, existing.st_mode & 07777) == 0;
+
+        ok = ok && write_segments(fd, text, progress);
+
+        if (ok && sync != SyncPolicy::NONE)
+            ok = fsync(fd) == 0;
+
+        ok = close(fd) == 0 && ok;
+        ok = ok && rename(temp_path.c_str(), file_path.c_str()) == 0;
+
+        if (!ok)
+        {
+            unlink(temp_path.c_str());
+            return false;
+        }
+
+        if (sync == SyncPolicy::FILE_AND_DIRECTORY)
+            return sync_directory(file_path);
+
+        return true;
+    }
+}
+
+bool write_file(const std::string &file_path, const TextView &text, SyncPolicy sync)
+{
+    return write_text(file_path, text, sync, nullptr);
+}
+
+bool write_file(const std::string &file_path, const TextSnapshot &text, SyncPolicy sync, const WriteProgress &progress)
+{
+    return write_text(file_path, text, sync, progress);
+}
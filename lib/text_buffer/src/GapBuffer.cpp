@@ -0,0 +1,248 @@
+#include "text_buffer/GapBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+GapBuffer::GapBuffer() : GapBuffer(GapPolicy()) {};
+
+GapBuffer::GapBuffer(GapPolicy gap_policy) : policy(gap_policy)
+{
+    gap_len = policy.min_gap;
+    buffer.resize(gap_len);
+
+    gap_pos = 0;
+}
+
+void GapBuffer::insert(int index, std::string_view text)
+{
+    int text_len = static_cast<int>(text.size());
+
+    move_gap(index);
+
+    if (gap_len < text_len)
+        grow_gap(text_len);
+
+    std::memcpy(buffer.data() + gap_pos, text.data(), text_len);
+    gap_pos += text_len;
+    gap_len -= text_len;
+}
+
+void GapBuffer::erase(int index, int length)
+{
+    /* With the gap at index, the erased text is directly after the gap, so absorbing it into the gap
+    is all that's needed. */
+    move_gap(index);
+    gap_len += std::min(length, size() - index);
+}
+
+void GapBuffer::replace(std::span<const Replacement> replacements)
+{
+    if (replacements.empty())
+        return;
+
+    /* The gap has to hold however much the text has grown by at any point in the sweep. */
+    int growth = 0;
+    int max_growth = 0;
+
+    for (const Replacement &replacement : replacements)
+    {
+        growth += static_cast<int>(replacement.text.size()) - replacement.length;
+        max_growth = std::max(max_growth, growth);
+    }
+
+    if (gap_len < max_growth)
+        grow_gap(max_growth);
+
+    /* Sweep the gap from the first replacement to the last. The kept text in between crosses over
+    to before the gap, replaced text is absorbed into the gap, and new text is written into it, so
+    only the text between the first and last replacements moves, and it only moves once. */
+    move_gap(replacements.front().index);
+
+    int swept = replacements.front().index;
+
+    for (const Replacement &replacement : replacements)
+    {
+        int kept_len = replacement.index - swept;
+
+        std::memmove(buffer.data() + gap_pos, buffer.data() + gap_pos + gap_len, kept_len);
+        gap_pos += kept_len;
+
+        gap_len += replacement.length;
+
+        /* Erasures have no text, and their data() can be null, which memcpy() mustn't be given. */
+        if (!replacement.text.empty())
+            std::memcpy(buffer.data() + gap_pos, replacement.text.data(), replacement.text.size());
+
+        gap_pos += static_cast<int>(replacement.text.size());
+        gap_len -= static_cast<int>(replacement.text.size());
+
+        swept = replacement.index + replacement.length;
+    }
+}
+
+std::string GapBuffer::read(int index, int length)
+{
+    std::string text;
+    text.reserve(length);
+
+    int end = std::min(index + length, size());
+
+    /* Read the part before the gap, then the part after it. */
+    if (index < gap_pos)
+        text.append(buffer.data() + index, std::min(end, gap_pos) - index);
+
+    if (end > gap_pos)
+    {
+        int start = std::max(index, gap_pos);
+        text.append(buffer.data() + to_buffer_space(start), end - start);
+    }
+
+    return text;
+}
+
+std::span<const char> GapBuffer::segment(int index)
+{
+    if (index < gap_pos)
+        return std::span<const char>(buffer.data() + index, gap_pos - index);
+
+    return std::span<const char>(buffer.data() + to_buffer_space(index), size() - index);
+}
+
+std::vector<std::span<const char>> GapBuffer::segments()
+{
+    auto [before, after] = spans();
+    return {before, after};
+}
+
+std::pair<std::span<const char>, std::span<const char>> GapBuffer::spans()
+{
+    std::span<const char> before(buffer.data(), gap_pos);
+    std::span<const char> after(buffer.data() + gap_pos + gap_len, size() - gap_pos);
+
+    return {before, after};
+}
+
+std::shared_ptr<const TextSnapshot> GapBuffer::snapshot()
+{
+    /* Gap moves rewrite the buffer, so unlike a piece table there's nothing immutable to share and
+    the text has to be copied. */
+    std::shared_ptr<std::string> text = std::make_shared<std::string>(read(0, size()));
+    std::vector<std::span<const char>> segments = {std::span<const char>(text->data(), text->size())};
+
+    return std::make_shared<const TextSnapshot>(std::move(segments), std::vector<std::shared_ptr<const void>>{text});
+}
+
+std::shared_ptr<const std::vector<char>> GapBuffer::take_text()
+{
+    move_gap(size());
+    buffer.resize(gap_pos);
+
+    std::shared_ptr<const std::vector<char>> text = std::make_shared<const std::vector<char>>(std::move(buffer));
+    clear();
+
+    return text;
+}
+
+char GapBuffer::at(int index)
+{
+    return buffer[to_buffer_space(index)];
+}
+
+int GapBuffer::size()
+{
+    return static_cast<int>(buffer.size()) - gap_len;
+}
+
+void GapBuffer::clear()
+{
+    gap_len = policy.min_gap;
+    buffer = std::vector<char>(gap_len);
+
+    gap_pos = 0;
+}
+
+void GapBuffer::compact()
+{
+    int target_len = target_gap_len(size());
+
+    if (gap_len <= target_len * policy.shrink_factor)
+        return;
+
+    resize_gap(target_len);
+}
+
+void GapBuffer::debug(std::ostream &os)
+{
+    os << "= Gap = " << std::endl;
+    os << "gap len = " << gap_len << ", gap pos = " << gap_pos << std::endl;
+
+    os << "\n= Buffer =" << std::endl;
+
+    std::size_t gap_start = static_cast<std::size_t>(gap_pos);
+    std::size_t gap_end = gap_start + static_cast<std::size_t>(gap_len);
+
+    for (std::size_t i = 0; i < buffer.size(); i++)
+    {
+        if (i >= gap_start && i < gap_end)
+            os << i << ": _ (gap)";
+        else if (buffer[i] == '\n')
+            os << i << ": \\n";
+        else
+            os << i << ": " << buffer[i];
+
+        os << std::endl;
+    }
+}
+
+void GapBuffer::move_gap(int index)
+{
+    /* Only the text between the old and new gap positions needs to move, as it just swaps over to
+    the other side of the gap. */
+    if (index < gap_pos)
+    {
+        int move_len = gap_pos - index;
+        std::memmove(buffer.data() + index + gap_len, buffer.data() + index, move_len);
+    }
+    else if (index > gap_pos)
+    {
+        int move_len = index - gap_pos;
+        std::memmove(buffer.data() + gap_pos, buffer.data() + gap_pos + gap_len, move_len);
+    }
+
+    gap_pos = index;
+}
+
+void GapBuffer::grow_gap(int required_len)
+{
+    resize_gap(std::max(required_len, target_gap_len(size())));
+}
+
+void GapBuffer::resize_gap(int new_gap_len)
+{
+    /* Copy the text either side of the gap into a fresh buffer, rather than resizing in place and
+    shifting everything after the gap (which would touch the tail twice). */
+    std::vector<char> new_buffer(buffer.size() - gap_len + new_gap_len);
+
+    auto gap_start = buffer.begin() + gap_pos;
+    auto gap_end = gap_start + gap_len;
+
+    std::copy(buffer.begin(), gap_start, new_buffer.begin());
+    std::copy(gap_end, buffer.end(), new_buffer.begin() + gap_pos + new_gap_len);
+
+    buffer = std::move(new_buffer);
+    gap_len = new_gap_len;
+}
+
+int GapBuffer::target_gap_len(int text_len)
+{
+    int proportional_len = static_cast<int>(text_len * policy.growth_factor);
+    return std::clamp(proportional_len, policy.min_gap, policy.max_gap);
+}
+
+int GapBuffer::to_buffer_space(int text_space_pos)
+{
+    if (text_space_pos < gap_pos)
+        return text_space_pos;
+
+    return text_space_pos + gap_len;
+}
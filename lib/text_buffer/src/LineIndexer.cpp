@@ -0,0 +1,99 @@
+#include "text_buffer/LineIndexer.h"
+#include "text_buffer/NewlineScan.h"
+
+#include <algorithm>
+#include <utility>
+
+LineIndexer::LineIndexer(std::string_view text, std::shared_ptr<const void> owner) : text(text), owner(std::move(owner))
+{
+    /* Started last, so that everything it uses is already initialised. */
+    thread = std::thread(&LineIndexer::run, this);
+}
+
+LineIndexer::~LineIndexer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    chunk_taken.notify_one();
+    thread.join();
+}
+
+std::size_t LineIndexer::chunk_count() const
+{
+    return (text.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+std::size_t LineIndexer::next_chunk_start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::min(taken * CHUNK_SIZE, text.size());
+}
+
+bool LineIndexer::finished()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return taken >= chunk_count();
+}
+
+bool LineIndexer::ready()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !scanned.empty();
+}
+
+std::vector<int> LineIndexer::take()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::size_t chunk = taken++;
+
+    if (!scanned.empty())
+    {
+        std::vector<int> newlines = std::move(scanned.front());
+        scanned.pop_front();
+
+        lock.unlock();
+        chunk_taken.notify_one();
+
+        return newlines;
+    }
+
+    /* The worker hasn't got this far, so scan it here rather than wait. The worker notices that it
+    has been taken and moves on to the next one. */
+    lock.unlock();
+
+    return scan(chunk);
+}
+
+void LineIndexer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        chunk_taken.wait(lock, [this]
+                         { return stopping || scanned.size() < MAX_CHUNKS_AHEAD; });
+
+        std::size_t chunk = taken + scanned.size();
+
+        if (stopping || chunk >= chunk_count())
+            return;
+
+        lock.unlock();
+        std::vector<int> newlines = scan(chunk);
+        lock.lock();
+
+        /* Dropped if it was taken (and so scanned by the taker) in the meantime. */
+        if (chunk == taken + scanned.size())
+            scanned.push_back(std::move(newlines));
+    }
+}
+
+std::vector<int> LineIndexer::scan(std::size_t chunk) const
+{
+    std::size_t start = chunk * CHUNK_SIZE;
+
+    return find_newlines(text.substr(start, std::min(CHUNK_SIZE, text.size() - start)));
+}
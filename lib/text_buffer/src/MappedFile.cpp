@@ -0,0 +1,55 @@
+#include "text_buffer/MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &file_path)
+{
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat file_stat;
+
+    if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) > MAX_SIZE)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    std::size_t size = static_cast<std::size_t>(file_stat.st_size);
+
+    /* mmap() rejects zero-length mappings, but there's nothing to map for an empty file anyway. */
+    if (size == 0)
+    {
+        close(fd);
+        return std::shared_ptr<MappedFile>(new MappedFile(nullptr, 0));
+    }
+
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping keeps its own reference to the file, so the descriptor isn't needed any more. */
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    /* The line index is built with a single front-to-back pass, so let the kernel read ahead. */
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    return std::shared_ptr<MappedFile>(new MappedFile(static_cast<const char *>(data), size));
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+        munmap(const_cast<char *>(data), size);
+}
+
+std::string_view MappedFile::text() const
+{
+    return std::string_view(data, size);
+}
@@ -0,0 +1,164 @@
+#include "text_buffer/NewlineScan.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TEXT_BUFFER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    /* Bytes scanned per call when scanning in chunks, which bounds the scratch buffer size. */
+    constexpr std::size_t SCAN_CHUNK_SIZE = 64 * 1024;
+
+    /* Scans [start, end) a byte at a time, appending to the count positions already found. Also
+    used for the tails that are too short for a full vector. */
+    std::size_t scan_scalar(const char *data, std::size_t start, std::size_t end, int *positions, std::size_t count)
+    {
+        for (std::size_t i = start; i < end; i++)
+        {
+            if (data[i] == '\n')
+                positions[count++] = static_cast<int>(i);
+        }
+
+        return count;
+    }
+
+#ifdef TEXT_BUFFER_X86
+    /* Turns a bitmask of newline positions within the block starting at index into positions. */
+    inline std::size_t append_mask(unsigned int mask, std::size_t index, int *positions, std::size_t count)
+    {
+        while (mask != 0)
+        {
+            positions[count++] = static_cast<int>(index) + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+
+        return count;
+    }
+
+    __attribute__((target("sse2"))) std::size_t find_newlines_sse2(const char *data, std::size_t size, int *positions)
+    {
+        const __m128i newline = _mm_set1_epi8('\n');
+
+        std::size_t count = 0;
+        std::size_t i = 0;
+
+        for (; i + 16 <= size; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+
+            count = append_mask(mask, i, positions, count);
+        }
+
+        return scan_scalar(data, i, size, positions, count);
+    }
+
+    __attribute__((target("avx2"))) std::size_t find_newlines_avx2(const char *data, std::size_t size, int *positions)
+    {
+        const __m256i newline = _mm256_set1_epi8('\n');
+
+        std::size_t count = 0;
+        std::size_t i = 0;
+
+        /* Two blocks per iteration, so that long runs without newlines (the common case) cost a
+        single branch per 64 bytes. */
+        for (; i + 64 <= size; i += 64)
+        {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32));
+
+            __m256i first_matches = _mm256_cmpeq_epi8(first, newline);
+            __m256i second_matches = _mm256_cmpeq_epi8(second, newline);
+
+            if (_mm256_testz_si256(_mm256_or_si256(first_matches, second_matches), _mm256_set1_epi8(-1)))
+                continue;
+
+            count = append_mask(static_cast<unsigned int>(_mm256_movemask_epi8(first_matches)), i, positions, count);
+            count = append_mask(static_cast<unsigned int>(_mm256_movemask_epi8(second_matches)), i + 32, positions, count);
+        }
+
+        for (; i + 32 <= size; i += 32)
+        {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+
+            count = append_mask(mask, i, positions, count);
+        }
+
+        return scan_scalar(data, i, size, positions, count);
+    }
+#endif
+} /* namespace */
+
+ScanKernel best_scan_kernel()
+{
+    static const ScanKernel kernel = []
+    {
+        if (scan_kernel_supported(ScanKernel::AVX2))
+            return ScanKernel::AVX2;
+
+        if (scan_kernel_supported(ScanKernel::SSE2))
+            return ScanKernel::SSE2;
+
+        return ScanKernel::SCALAR;
+    }();
+
+    return kernel;
+}
+
+bool scan_kernel_supported(ScanKernel kernel)
+{
+    switch (kernel)
+    {
+    case ScanKernel::SCALAR:
+        return true;
+#ifdef TEXT_BUFFER_X86
+    case ScanKernel::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case ScanKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+std::size_t find_newlines(const char *data, std::size_t size, int *positions)
+{
+    return find_newlines(best_scan_kernel(), data, size, positions);
+}
+
+std::size_t find_newlines(ScanKernel kernel, const char *data, std::size_t size, int *positions)
+{
+    switch (kernel)
+    {
+#ifdef TEXT_BUFFER_X86
+    case ScanKernel::SSE2:
+        return find_newlines_sse2(data, size, positions);
+    case ScanKernel::AVX2:
+        return find_newlines_avx2(data, size, positions);
+#endif
+    default:
+        return scan_scalar(data, 0, size, positions, 0);
+    }
+}
+
+std::vector<int> find_newlines(std::string_view text)
+{
+    std::vector<int> positions;
+    std::vector<int> scratch(std::min(text.size(), SCAN_CHUNK_SIZE));
+
+    for (std::size_t chunk_start = 0; chunk_start < text.size(); chunk_start += SCAN_CHUNK_SIZE)
+    {
+        std::size_t chunk_size = std::min(SCAN_CHUNK_SIZE, text.size() - chunk_start);
+        std::size_t count = find_newlines(text.data() + chunk_start, chunk_size, scratch.data());
+
+        for (std::size_t i = 0; i < count; i++)
+            positions.push_back(static_cast<int>(chunk_start) + scratch[i]);
+    }
+
+    return positions;
+}
@@ -0,0 +1,272 @@
+#include "text_buffer/PieceTable.h"
+
+#include <algorithm>
+#include <vector>
+
+PieceTable::PieceTable() : PieceTable(std::string_view(), nullptr) {};
+
+PieceTable::PieceTable(std::string_view original, std::shared_ptr<const void> owner)
+    : original(original), original_owner(owner), added(std::make_shared<TextArena>())
+{
+    if (!original.empty())
+        pieces.insert(0, Piece{PieceSource::ORIGINAL, original.data(), static_cast<int>(original.size())});
+}
+
+void PieceTable::insert(int index, std::string_view text)
+{
+    if (text.empty())
+        return;
+
+    std::string_view added_text = added->append(text);
+    int text_len = static_cast<int>(text.size());
+
+    /* Find the piece that will come directly before the new text, splitting a piece in two if the
+    insert lands in the middle of it. */
+    int insert_at = pieces.size();
+
+    if (index < size())
+    {
+        auto [piece_index, offset] = pieces.find(index);
+        insert_at = piece_index;
+
+        if (offset > 0)
+        {
+            Piece piece = pieces.at(piece_index);
+
+            pieces.set(piece_index, Piece{piece.source, piece.data, offset});
+            pieces.insert(piece_index + 1, Piece{piece.source, piece.data + offset, piece.length - offset});
+
+            insert_at = piece_index + 1;
+        }
+    }
+
+    /* Typing appends to the added buffer right after the previously typed text (unless it just
+    started a new block), in which case the previous piece can just be extended rather than adding
+    a piece per keystroke. */
+    if (insert_at > 0)
+    {
+        const Piece &previous = pieces.at(insert_at - 1);
+
+        if (previous.source == PieceSource::ADDED && previous.data + previous.length == added_text.data())
+        {
+            pieces.add_length(insert_at - 1, text_len);
+            return;
+        }
+    }
+
+    pieces.insert(insert_at, Piece{PieceSource::ADDED, added_text.data(), text_len});
+}
+
+void PieceTable::erase(int index, int length)
+{
+    length = std::min(length, size() - index);
+
+    if (length <= 0)
+        return;
+
+    auto [first, first_offset] = pieces.find(index);
+    auto [last, last_offset] = pieces.find(index + length - 1);
+
+    /* Keep whatever is left of the first and last pieces either side of the erased text. */
+    std::vector<Piece> remaining;
+
+    if (first_offset > 0)
+    {
+        const Piece &piece = pieces.at(first);
+        remaining.push_back(Piece{piece.source, piece.data, first_offset});
+    }
+
+    const Piece &last_piece = pieces.at(last);
+    int last_remaining = last_piece.length - last_offset - 1;
+
+    if (last_remaining > 0)
+        remaining.push_back(Piece{last_piece.source, last_piece.data + last_offset + 1, last_remaining});
+
+    pieces.erase(first, last + 1);
+    pieces.insert(first, std::span<const Piece>(remaining));
+}
+
+void PieceTable::replace(std::span<const Replacement> replacements)
+{
+    if (replacements.empty())
+        return;
+
+    std::vector<Piece> old_pieces;
+    old_pieces.reserve(pieces.size());
+
+    pieces.for_each([&](int, int, const Piece &piece)
+                    { old_pieces.push_back(piece); });
+
+    std::vector<Piece> new_pieces;
+    new_pieces.reserve(old_pieces.size() + 2 * replacements.size());
+
+    /* Pieces that carry straight on from the previous one (e.g. the original text either side of an
+    empty replacement) are merged back together. */
+    auto add = [&new_pieces](const Piece &piece)
+    {
+        if (piece.length == 0)
+            return;
+
+        if (!new_pieces.empty())
+        {
+            Piece &previous = new_pieces.back();
+
+            if (previous.source == piece.source && previous.data + previous.length == piece.data)
+            {
+                previous.length += piece.length;
+                return;
+            }
+        }
+
+        new_pieces.push_back(piece);
+    };
+
+    /* Walks through the old pieces up to the text space index end, keeping their text or not. */
+    std::size_t piece_index = 0;
+    int piece_start = 0;
+    int position = 0;
+
+    auto advance = [&](int end, bool keep)
+    {
+        while (position < end)
+        {
+            const Piece &piece = old_pieces[piece_index];
+            int offset = position - piece_start;
+            int length = std::min(piece.length - offset, end - position);
+
+            if (keep)
+                add(Piece{piece.source, piece.data + offset, length});
+
+            position += length;
+
+            if (offset + length == piece.length)
+            {
+                piece_start += piece.length;
+                piece_index++;
+            }
+        }
+    };
+
+    /* Replace-all tends to use the same text every time, which only needs adding once. */
+    std::string_view previous_text;
+    std::string_view previous_added;
+
+    for (const Replacement &replacement : replacements)
+    {
+        advance(replacement.index, true);
+        advance(replacement.index + replacement.length, false);
+
+        if (replacement.text.empty())
+            continue;
+
+        if (previous_added.empty() || replacement.text != previous_text)
+        {
+            previous_text = replacement.text;
+            previous_added = added->append(replacement.text);
+        }
+
+        add(Piece{PieceSource::ADDED, previous_added.data(), static_cast<int>(previous_added.size())});
+    }
+
+    advance(size(), true);
+
+    pieces.assign(new_pieces);
+}
+
+std::string PieceTable::read(int index, int length)
+{
+    std::string text;
+    length = std::min(length, size() - index);
+
+    if (length <= 0)
+        return text;
+
+    text.reserve(length);
+
+    auto [piece_index, offset] = pieces.find(index);
+
+    while (length > 0)
+    {
+        const Piece &piece = pieces.at(piece_index);
+        int read_len = std::min(piece.length - offset, length);
+
+        text.append(piece.data + offset, read_len);
+
+        length -= read_len;
+        offset = 0;
+        piece_index++;
+    }
+
+    return text;
+}
+
+std::span<const char> PieceTable::segment(int index)
+{
+    if (index < 0 || index >= size())
+        return std::span<const char>();
+
+    auto [piece_index, offset] = pieces.find(index);
+    const Piece &piece = pieces.at(piece_index);
+
+    return std::span<const char>(piece.data + offset, piece.length - offset);
+}
+
+std::vector<std::span<const char>> PieceTable::segments()
+{
+    std::vector<std::span<const char>> segments;
+    segments.reserve(pieces.size());
+
+    pieces.for_each([&](int, int, const Piece &piece)
+                    { segments.emplace_back(piece.data, piece.length); });
+
+    return segments;
+}
+
+std::shared_ptr<const TextSnapshot> PieceTable::snapshot()
+{
+    /* Only the pieces are copied. The text itself is shared with the original and added buffers. */
+    return std::make_shared<const TextSnapshot>(segments(), std::vector<std::shared_ptr<const void>>{original_owner, added});
+}
+
+bool PieceTable::has_cheap_snapshots()
+{
+    return true;
+}
+
+char PieceTable::at(int index)
+{
+    auto [piece_index, offset] = pieces.find(index);
+    return pieces.at(piece_index).data[offset];
+}
+
+int PieceTable::size()
+{
+    return pieces.total_length();
+}
+
+void PieceTable::clear()
+{
+    pieces.clear();
+    /* A snapshot may still be using the old arena, so start a new one rather than clearing it. */
+    added = std::make_shared<TextArena>();
+
+    original = std::string_view();
+    original_owner = nullptr;
+}
+
+void PieceTable::debug(std::ostream &os)
+{
+    os << "= Pieces =" << std::endl;
+
+    pieces.for_each([&](int, int start_index, const Piece &piece)
+                    {
+                        os << "text index = " << start_index;
+
+                        /* Added text has no single buffer to give an offset into, so show where it is. */
+                        if (piece.source == PieceSource::ORIGINAL)
+                            os << ", source = original, start = " << piece.data - original.data();
+                        else
+                            os << ", source = added, at = " << static_cast<const void *>(piece.data);
+
+                        os << ", length = " << piece.length << std::endl; });
+}
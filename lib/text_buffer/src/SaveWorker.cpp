@@ -0,0 +1,105 @@
+#include "text_buffer/SaveWorker.h"
+
+#include <tracing/Trace.h>
+
+#include <utility>
+
+SaveWorker::SaveWorker()
+{
+    /* Started last, so that everything it uses is already initialised. */
+    thread = std::thread(&SaveWorker::run, this);
+}
+
+SaveWorker::~SaveWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    job_queued.notify_one();
+    thread.join();
+}
+
+void SaveWorker::save(std::shared_ptr<const TextSnapshot> snapshot, const std::string &file_path, SyncPolicy sync, int version)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = Job{std::move(snapshot), file_path, sync, version};
+    }
+
+    job_queued.notify_one();
+}
+
+void SaveWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    job_finished.wait(lock, [this]
+                      { return !pending && !writing; });
+}
+
+bool SaveWorker::busy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending || writing;
+}
+
+SaveStatus SaveWorker::status()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    SaveStatus status = current_status;
+
+    if (status.state == SaveState::SAVING)
+        status.bytes_written = bytes_written.load(std::memory_order_relaxed);
+
+    return status;
+}
+
+void SaveWorker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        /* Pending saves are still written when stopping, as the user asked for them. */
+        job_queued.wait(lock, [this]
+                        { return pending || stopping; });
+
+        if (!pending)
+            return;
+
+        Job job = std::move(*pending);
+        pending.reset();
+        writing = true;
+
+        bytes_written = 0;
+        current_status.state = SaveState::SAVING;
+        current_status.file_path = job.file_path;
+        current_status.bytes_written = 0;
+        current_status.bytes_total = job.snapshot->size();
+        current_status.version = job.version;
+
+        lock.unlock();
+
+        TRACE(tracing::Level::INFO, "background save of %zu bytes to %s", job.snapshot->size(), job.file_path.c_str());
+
+        bool saved = write_file(job.file_path, *job.snapshot, job.sync, [this](std::size_t written)
+                                { bytes_written.store(written, std::memory_order_relaxed); });
+
+        if (!saved)
+            TRACE(tracing::Level::ERROR, "background save to %s failed", job.file_path.c_str());
+
+        /* Let go of the snapshot (and so whatever memory it was keeping alive) straight away. */
+        job.snapshot.reset();
+
+        lock.lock();
+
+        writing = false;
+        current_status.state = saved ? SaveState::SUCCEEDED : SaveState::FAILED;
+        current_status.bytes_written = saved ? current_status.bytes_total : bytes_written.load();
+        current_status.finished_count++;
+
+        job_finished.notify_all();
+    }
+}
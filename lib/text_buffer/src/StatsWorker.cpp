@@ -0,0 +1,295 @@
+#include "text_buffer/StatsWorker.h"
+
+#include <tracing/Trace.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    bool is_space(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    StatsWorker::Summary count_text(const char *data, std::size_t size)
+    {
+        StatsWorker::Summary summary;
+        summary.bytes = size;
+
+        if (size == 0)
+            return summary;
+
+        bool in_word = false;
+        std::size_t line_start = 0;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            char c = data[i];
+            bool space = is_space(c);
+
+            if (!space && !in_word)
+                summary.words++;
+
+            in_word = !space;
+
+            if (c == '\n')
+            {
+                std::size_t length = i - line_start;
+
+                if (summary.newlines == 0)
+                    summary.first_line = length;
+                else
+                    summary.longest_inner_line = std::max(summary.longest_inner_line, length);
+
+                summary.newlines++;
+                line_start = i + 1;
+            }
+        }
+
+        if (summary.newlines == 0)
+            summary.first_line = size;
+
+        summary.last_line = size - line_start;
+        summary.starts_in_word = !is_space(data[0]);
+        summary.ends_in_word = in_word;
+
+        return summary;
+    }
+
+    /* Combines the counts of two runs of text, where after directly follows before. */
+    StatsWorker::Summary combine(const StatsWorker::Summary &before, const StatsWorker::Summary &after)
+    {
+        if (before.bytes == 0)
+            return after;
+
+        if (after.bytes == 0)
+            return before;
+
+        StatsWorker::Summary summary;
+        summary.bytes = before.bytes + after.bytes;
+        summary.newlines = before.newlines + after.newlines;
+
+        /* A word running across the join was counted on both sides. */
+        summary.words = before.words + after.words - (before.ends_in_word && after.starts_in_word ? 1 : 0);
+
+        summary.first_line = before.newlines > 0 ? before.first_line : before.bytes + after.first_line;
+        summary.last_line = after.newlines > 0 ? after.last_line : before.last_line + after.bytes;
+
+        /* The line across the join is only between two newlines if both sides have one. Otherwise
+        it's part of the combined first or last line. */
+        summary.longest_inner_line = std::max(before.longest_inner_line, after.longest_inner_line);
+
+        if (before.newlines > 0 && after.newlines > 0)
+            summary.longest_inner_line = std::max(summary.longest_inner_line, before.last_line + after.first_line);
+
+        summary.starts_in_word = before.starts_in_word;
+        summary.ends_in_word = after.ends_in_word;
+
+        return summary;
+    }
+}
+
+std::size_t StatsWorker::SegmentKeyHash::operator()(const SegmentKey &key) const
+{
+    return std::hash<const char *>()(key.data) ^ (std::hash<std::size_t>()(key.size) * 31);
+}
+
+StatsWorker::StatsWorker()
+{
+    /* Started last, so that everything it uses is already initialised. */
+    thread = std::thread(&StatsWorker::run, this);
+}
+
+StatsWorker::~StatsWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    snapshot_queued.notify_one();
+    thread.join();
+}
+
+void StatsWorker::update(std::shared_ptr<const TextSnapshot> snapshot, int version)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = std::move(snapshot);
+        pending_version = version;
+    }
+
+    snapshot_queued.notify_one();
+}
+
+void StatsWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    snapshot_counted.wait(lock, [this]
+                          { return pending == nullptr && !counting; });
+}
+
+bool StatsWorker::busy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending != nullptr || counting;
+}
+
+TextStats StatsWorker::stats() const
+{
+    TextStats stats;
+    unsigned before, after;
+
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+
+        stats.version = published_version.load(std::memory_order_relaxed);
+        stats.line_count = published_lines.load(std::memory_order_relaxed);
+        stats.byte_count = published_bytes.load(std::memory_order_relaxed);
+        stats.word_count = published_words.load(std::memory_order_relaxed);
+        stats.longest_line = published_longest.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    } while (before != after || before % 2 != 0);
+
+    stats.counted = before > 0;
+
+    return stats;
+}
+
+void StatsWorker::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        snapshot_queued.wait(lock, [this]
+                             { return pending != nullptr || stopping; });
+
+        if (stopping)
+            return;
+
+        std::shared_ptr<const TextSnapshot> snapshot = std::move(pending);
+        int version = pending_version;
+        counting = true;
+
+        lock.unlock();
+
+        Summary total;
+
+        if (count(*snapshot, total))
+        {
+            publish(total, version);
+
+            /* Keep the snapshot, as the cached counts are keyed by its memory. */
+            last_counted = std::move(snapshot);
+        }
+
+        lock.lock();
+        counting = false;
+
+        snapshot_counted.notify_all();
+    }
+}
+
+bool StatsWorker::count(const TextSnapshot &snapshot, Summary &total)
+{
+    std::vector<std::span<const char>> segments;
+
+    snapshot.for_each_segment([&segments](std::span<const char> segment)
+                              { segments.push_back(segment); });
+
+    std::unordered_map<SegmentKey, Summary, SegmentKeyHash> new_segment_counts;
+    std::unordered_map<const char *, Summary> new_block_counts;
+    std::size_t bytes_read = 0;
+
+    for (std::span<const char> segment : segments)
+    {
+        total = combine(total, count_segment(segment, new_segment_counts, new_block_counts, bytes_read));
+
+        if (stopping.load(std::memory_order_relaxed))
+            return false;
+    }
+
+    segment_counts = std::move(new_segment_counts);
+    block_counts = std::move(new_block_counts);
+
+    TRACE(tracing::Level::DEBUG, "counted %zu bytes, %zu of them read again", snapshot.size(), bytes_read);
+
+    return true;
+}
+
+StatsWorker::Summary StatsWorker::count_segment(std::span<const char> segment, std::unordered_map<SegmentKey, Summary, SegmentKeyHash> &new_segment_counts, std::unordered_map<const char *, Summary> &new_block_counts, std::size_t &bytes_read)
+{
+    if (segment.empty())
+        return Summary();
+
+    const char *data = segment.data();
+    const char *end = data + segment.size();
+
+    /* The blocks wholly inside the segment. Anything either side of them is counted on its own. */
+    const char *first_block = data + (BLOCK_SIZE - reinterpret_cast<std::uintptr_t>(data) % BLOCK_SIZE) % BLOCK_SIZE;
+    const char *blocks_end = end - reinterpret_cast<std::uintptr_t>(end) % BLOCK_SIZE;
+
+    if (first_block > blocks_end)
+        first_block = blocks_end = end;
+
+    auto cached = segment_counts.find(SegmentKey{data, segment.size()});
+    bool segment_cached = cached != segment_counts.end();
+
+    Summary summary = segment_cached ? cached->second : count_text(data, first_block - data);
+
+    /* The blocks of a cached segment are carried over too, for when it's split by a later edit. */
+    for (const char *block = first_block; block < blocks_end && !stopping.load(std::memory_order_relaxed); block += BLOCK_SIZE)
+    {
+        auto cached_block = block_counts.find(block);
+        Summary block_summary;
+
+        if (cached_block != block_counts.end())
+            block_summary = cached_block->second;
+        else if (segment_cached)
+            continue;
+        else
+        {
+            block_summary = count_text(block, BLOCK_SIZE);
+            bytes_read += BLOCK_SIZE;
+        }
+
+        new_block_counts.emplace(block, block_summary);
+
+        if (!segment_cached)
+            summary = combine(summary, block_summary);
+    }
+
+    if (!segment_cached)
+    {
+        summary = combine(summary, count_text(blocks_end, end - blocks_end));
+        bytes_read += (first_block - data) + (end - blocks_end);
+    }
+
+    new_segment_counts.emplace(SegmentKey{data, segment.size()}, summary);
+
+    return summary;
+}
+
+void StatsWorker::publish(const Summary &total, int version)
+{
+    unsigned current = sequence.load(std::memory_order_relaxed);
+
+    sequence.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    published_version.store(version, std::memory_order_relaxed);
+    published_lines.store(total.newlines + 1, std::memory_order_relaxed);
+    published_bytes.store(total.bytes, std::memory_order_relaxed);
+    published_words.store(total.words, std::memory_order_relaxed);
+    published_longest.store(std::max({total.longest_inner_line, total.first_line, total.last_line}), std::memory_order_relaxed);
+
+    sequence.store(current + 2, std::memory_order_release);
+}
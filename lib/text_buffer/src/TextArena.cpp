@@ -0,0 +1,62 @@
+#include "text_buffer/TextArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+TextArena::TextArena(std::size_t block_size) : block_size(std::max<std::size_t>(block_size, 1)) {};
+
+std::string_view TextArena::append(std::string_view text)
+{
+    if (text.empty())
+        return std::string_view();
+
+    if (blocks.empty() || blocks.back().capacity - last_block_used < text.size())
+    {
+        std::size_t capacity = std::max(block_size, text.size());
+
+        blocks.push_back(Block{std::make_unique_for_overwrite<char[]>(capacity), capacity});
+        last_block_used = 0;
+        allocated += capacity;
+    }
+
+    char *destination = blocks.back().data.get() + last_block_used;
+    std::memcpy(destination, text.data(), text.size());
+    last_block_used += text.size();
+
+    return std::string_view(destination, text.size());
+}
+
+void TextArena::release_front(const char *data)
+{
+    /* The blocks are separate allocations, so pointers into them can only be ordered with
+    std::less (which gives a total order), not with <. */
+    std::less<const char *> before;
+
+    auto holds_data = [&](const Block &block)
+    {
+        return !before(data, block.data.get()) && before(data, block.data.get() + block.capacity);
+    };
+
+    auto holder = std::find_if(blocks.begin(), blocks.end(), holds_data);
+
+    if (holder == blocks.end())
+        return;
+
+    for (auto block = blocks.begin(); block != holder; block++)
+        allocated -= block->capacity;
+
+    blocks.erase(blocks.begin(), holder);
+}
+
+void TextArena::clear()
+{
+    blocks.clear();
+    last_block_used = 0;
+    allocated = 0;
+}
+
+std::size_t TextArena::memory_usage() const
+{
+    return allocated;
+}
@@ -1,120 +1,380 @@
 #include "text_buffer/TextBuffer.h"
+#include "text_buffer/MappedFile.h"
+
+#include <tracing/Latency.h>
+#include <tracing/Trace.h>
 
 #include <algorithm>
-#include <fstream>
+#include <utility>
+#include <vector>
+
+TextView LineRange::Iterator::operator*() const
+{
+    return buffer->get_line(line_num);
+}
 
-TextBuffer::TextBuffer()
+TextBuffer::TextBuffer() : TextBuffer(StorageKind::GAP_BUFFER) {};
+
+TextBuffer::TextBuffer(StorageKind storage_kind)
 {
-    gap_len = GAP_SIZE;
-    buffer.resize(gap_len);
+    if (storage_kind == StorageKind::PIECE_TABLE)
+        storage = std::make_unique<PieceTable>();
+    else
+        storage = std::make_unique<GapBuffer>();
 
-    buffer_space_cursor_pos = 0;
-    gap_pos = 0;
+    cursor_pos = 0;
     current_line = 0;
+}
+
+TextBuffer::TextBuffer(GapPolicy gap_policy) : storage(std::make_unique<GapBuffer>(gap_policy))
+{
+    cursor_pos = 0;
+    current_line = 0;
+}
+
+bool TextBuffer::open(const std::string &file_path)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::open(file_path);
+
+    if (file == nullptr)
+        return false;
+
+    storage = std::make_unique<PieceTable>(file->text(), file);
+    metadata.rebuild_lazily(file->text(), file);
+
+    add_damage(0, std::numeric_limits<int>::max());
+    history.clear();
+
+    cursor_pos = 0;
+    current_line = 0;
+    extra_cursors.clear();
+
+    TRACE(tracing::Level::INFO, "opened %s (%zu bytes)", file_path.c_str(), file->text().size());
+
+    return true;
+}
+
+bool TextBuffer::save(const std::string &file_path, SyncPolicy sync)
+{
+    bool saved = write_file(file_path, get_text(), sync);
+
+    if (saved)
+        TRACE(tracing::Level::INFO, "saved %d chars to %s", storage->size(), file_path.c_str());
+    else
+        TRACE(tracing::Level::ERROR, "failed to save to %s", file_path.c_str());
+
+    return saved;
+}
+
+std::shared_ptr<const TextSnapshot> TextBuffer::snapshot()
+{
+    return storage->snapshot();
+}
+
+bool TextBuffer::has_cheap_snapshots()
+{
+    return storage->has_cheap_snapshots();
+}
+
+void TextBuffer::use_piece_table()
+{
+    GapBuffer *gap_buffer = dynamic_cast<GapBuffer *>(storage.get());
 
-    debug();
+    if (gap_buffer == nullptr)
+        return;
+
+    /* The text and its line metadata stay exactly as they were, so nothing else needs updating. */
+    std::shared_ptr<const std::vector<char>> text = gap_buffer->take_text();
+    storage = std::make_unique<PieceTable>(std::string_view(text->data(), text->size()), text);
+
+    TRACE(tracing::Level::INFO, "switched to a piece table (%zu bytes)", text->size());
 }
 
 void TextBuffer::set_cursor_pos(int row, int col)
 {
-    int max_line = metadata.line_count() - 1; // Lines are zero-indexed, so subtract 1
-    current_line = std::min(row, max_line);
+    int new_pos = clamp_position(row, col);
 
-    /* Lines without a newline (i.e. the final line) allow the cursor to move one index beyond the
-    final text index, to allow for inserting at the end of the line. */
-    int selectable_indices = metadata.line_length(current_line);
+    /* Typing somewhere else starts a new undo step, even if it happens to carry on from the last. */
+    if (new_pos != cursor_pos)
+        history.seal();
 
-    /* Lines with a newline make the cursor stop at the newline (since it's invalid to insert
-    characters after a newline on a single line), and so subtract one from the line length to
-    account for the newline. */
-    if (!metadata.line_is_final(current_line))
-        selectable_indices--;
+    move_cursor_to(new_pos);
 
-    int offset = std::min(col, selectable_indices);
+    if (!extra_cursors.empty())
+        normalise_cursors();
 
-    int text_space_cursor_pos = metadata.line_start_index(current_line) + std::max(0, offset);
-    buffer_space_cursor_pos = to_buffer_space(text_space_cursor_pos);
+    TRACE(tracing::Level::DEBUG, "set cursor to %d (line %d)", cursor_pos, current_line);
+}
+
+void TextBuffer::add_cursor(int row, int col)
+{
+    int position = clamp_position(row, col);
+
+    if (position == cursor_pos)
+        return;
+
+    auto after = std::lower_bound(extra_cursors.begin(), extra_cursors.end(), position);
+
+    if (after == extra_cursors.end() || *after != position)
+        extra_cursors.insert(after, position);
 
-    debug();
+    history.seal();
 }
 
-void TextBuffer::insert(char c)
+void TextBuffer::clear_extra_cursors()
 {
-    move_gap();
+    extra_cursors.clear();
+}
 
-    buffer[buffer_space_cursor_pos] = c;
-    buffer_space_cursor_pos++;
-    gap_pos++;
-    gap_len--;
+const std::vector<int> &TextBuffer::get_extra_cursors()
+{
+    return extra_cursors;
+}
 
-    metadata.update_line_length(current_line, 1);
+void TextBuffer::insert(char c)
+{
+    insert(std::string_view(&c, 1));
+}
 
-    /* Split the line into two (or create a new one) on a newline. */
-    if (c == '\n')
+void TextBuffer::pop()
+{
+    if (!extra_cursors.empty())
     {
-        int text_space_cursor_pos = to_text_space(buffer_space_cursor_pos);
-        int relative_index = text_space_cursor_pos - metadata.line_start_index(current_line);
+        edit_at_cursors(std::string_view(), 1);
+        return;
+    }
+
+    if (cursor_pos == 0 || is_empty())
+        return;
+
+    erase(cursor_pos - 1, cursor_pos);
+}
 
-        metadata.split_line(current_line, relative_index);
-        current_line++;
+void TextBuffer::insert(std::string_view text)
+{
+    if (text.empty())
+        return;
+
+    if (!extra_cursors.empty())
+    {
+        edit_at_cursors(text, 0);
+        return;
     }
 
-    debug();
+    history.record_insert(cursor_pos, text, cursor_pos);
+    apply_insert(cursor_pos, text);
+
+    move_cursor_to(cursor_pos + static_cast<int>(text.size()));
 }
 
-void TextBuffer::pop()
+void TextBuffer::erase(int start, int end)
 {
-    move_gap();
+    start = std::max(start, 0);
+    end = std::min(end, storage->size());
 
-    if (buffer_space_cursor_pos == 0 || is_empty())
+    if (start >= end)
         return;
 
-    buffer_space_cursor_pos--;
-    gap_pos--;
-    gap_len++;
+    /* The erased text has to be copied out for undo, unless it's too big to keep anyway. */
+    if (history.fits(end - start))
+        history.record_erase(start, get_text().substr(start, end - start).to_string(), cursor_pos);
+    else
+        history.clear();
 
-    /* If crossing a line boundary, combine the lines into one. */
-    if (buffer[buffer_space_cursor_pos] == '\n')
+    apply_erase(start, end);
+
+    if (cursor_pos >= end)
+        cursor_pos -= end - start;
+    else if (cursor_pos > start)
+        cursor_pos = start;
+
+    current_line = metadata.line_of_offset(cursor_pos);
+
+    if (!extra_cursors.empty())
     {
-        metadata.merge_line(current_line);
-        current_line--;
+        Replacement erased{start, end - start, std::string_view()};
+        map_positions(extra_cursors, std::span<const Replacement>(&erased, 1));
+        normalise_cursors();
     }
+}
+
+void TextBuffer::replace(std::span<const Replacement> replacements)
+{
+    if (replacements.empty())
+        return;
 
-    metadata.update_line_length(current_line, -1);
+    std::size_t replaced_len = 0;
 
-    debug();
+    for (const Replacement &replacement : replacements)
+        replaced_len += replacement.length;
+
+    if (history.fits(replaced_len))
+    {
+        std::string replaced;
+        replaced.reserve(replaced_len);
+
+        for (const Replacement &replacement : replacements)
+            get_text().substr(replacement.index, replacement.length).for_each_segment([&replaced](std::span<const char> segment)
+                                                                                       { replaced.append(segment.data(), segment.size()); });
+
+        history.record_replace(replacements, replaced, cursor_pos);
+    }
+    else
+    {
+        history.clear();
+    }
+
+    /* The cursors move along with the text around them. */
+    std::vector<int> main_cursor = {cursor_pos};
+    map_positions(main_cursor, replacements);
+    map_positions(extra_cursors, replacements);
+
+    apply_replace(replacements);
+    move_cursor_to(main_cursor.front());
+
+    if (!extra_cursors.empty())
+        normalise_cursors();
 }
 
 void TextBuffer::clear()
 {
     metadata.clear();
+    storage->clear();
 
-    gap_len = GAP_SIZE;
-    buffer.resize(gap_len);
+    add_damage(0, std::numeric_limits<int>::max());
+    history.clear();
 
-    buffer_space_cursor_pos = 0;
-    gap_pos = 0;
+    cursor_pos = 0;
     current_line = 0;
+    extra_cursors.clear();
 }
 
-std::string TextBuffer::get_text()
+bool TextBuffer::undo()
 {
-    if (is_empty())
-        return "";
+    std::optional<UndoEdit> edit = history.undo();
+
+    if (!edit)
+        return false;
+
+    /* The history only knows where the main cursor was. */
+    extra_cursors.clear();
+
+    if (edit->kind == EditKind::REPLACE)
+    {
+        /* Put each replacement's old text back where its new text ended up. */
+        std::vector<Replacement> reverted;
+        reverted.reserve(edit->replacements.size());
+
+        int shift = 0;
+
+        for (const ReplacedText &replaced : edit->replacements)
+        {
+            reverted.push_back(Replacement{replaced.position + shift, static_cast<int>(replaced.after.size()), replaced.before});
+            shift += static_cast<int>(replaced.after.size()) - static_cast<int>(replaced.before.size());
+        }
+
+        apply_replace(reverted);
+        move_cursor_to(edit->cursor_before);
+
+        return true;
+    }
 
-    auto gap_start = buffer.begin() + gap_pos;
-    auto gap_end = buffer.begin() + gap_pos + gap_len;
+    if (edit->kind == EditKind::INSERT)
+        apply_erase(edit->position, edit->position + static_cast<int>(edit->text.size()));
+    else
+        apply_insert(edit->position, edit->text);
 
-    /* Check if there's no text after the gap. */
-    if (gap_end == buffer.end())
-        return std::string(buffer.begin(), gap_start);
+    move_cursor_to(edit->cursor_before);
 
-    return std::string(buffer.begin(), gap_start) + std::string(gap_end, buffer.end());
+    return true;
+}
+
+bool TextBuffer::redo()
+{
+    std::optional<UndoEdit> edit = history.redo();
+
+    if (!edit)
+        return false;
+
+    extra_cursors.clear();
+
+    if (edit->kind == EditKind::REPLACE)
+    {
+        std::vector<Replacement> replacements;
+        replacements.reserve(edit->replacements.size());
+
+        for (const ReplacedText &replaced : edit->replacements)
+            replacements.push_back(Replacement{replaced.position, static_cast<int>(replaced.before.size()), replaced.after});
+
+        apply_replace(replacements);
+        move_cursor_to(edit->position);
+
+        return true;
+    }
+
+    if (edit->kind == EditKind::INSERT)
+    {
+        apply_insert(edit->position, edit->text);
+        move_cursor_to(edit->position + static_cast<int>(edit->text.size()));
+    }
+    else
+    {
+        apply_erase(edit->position, edit->position + static_cast<int>(edit->text.size()));
+        move_cursor_to(edit->position);
+    }
+
+    return true;
+}
+
+void TextBuffer::compact()
+{
+    storage->compact();
+}
+
+TextView TextBuffer::get_text()
+{
+    return TextView(storage.get(), 0, storage->size());
+}
+
+TextView TextBuffer::get_line(int line_num, int start_col, int max_len)
+{
+    metadata.index_to_line(line_num);
+
+    if (line_num < 0 || line_num >= metadata.line_count())
+        return TextView();
+
+    int visible_len = metadata.line_length(line_num) - (metadata.line_is_final(line_num) ? 0 : 1);
+    int read_len = std::min(visible_len - start_col, max_len);
+
+    if (read_len <= 0)
+        return TextView();
+
+    return TextView(storage.get(), metadata.line_start_index(line_num) + start_col, read_len);
+}
+
+LineRange TextBuffer::lines(int first_line, int last_line)
+{
+    metadata.index_to_line(last_line - 1);
+
+    first_line = std::clamp(first_line, 0, metadata.line_count());
+    last_line = std::clamp(last_line, first_line, metadata.line_count());
+
+    return LineRange(this, first_line, last_line);
 }
 
 bool TextBuffer::is_empty()
 {
-    return buffer.size() == gap_len;
+    return storage->size() == 0;
+}
+
+int TextBuffer::get_cursor_row()
+{
+    return current_line;
+}
+
+int TextBuffer::get_cursor_col()
+{
+    return cursor_pos - metadata.line_start_index(current_line);
 }
 
 int TextBuffer::get_line_count()
@@ -122,6 +382,21 @@ int TextBuffer::get_line_count()
     return metadata.line_count();
 }
 
+bool TextBuffer::is_line_index_complete()
+{
+    return metadata.is_complete();
+}
+
+void TextBuffer::index_to_line(int line_num)
+{
+    metadata.index_to_line(line_num);
+}
+
+bool TextBuffer::poll_line_index()
+{
+    return metadata.poll_index();
+}
+
 int TextBuffer::get_line_length(int line_num)
 {
     return metadata.line_length(line_num);
@@ -132,97 +407,217 @@ bool TextBuffer::is_final_line(int line_num)
     return metadata.line_is_final(line_num);
 }
 
-void TextBuffer::move_gap()
+int TextBuffer::get_line_of_offset(int offset)
 {
-    /* Move cursor on write. */
-    if (buffer_space_cursor_pos != gap_pos)
-    {
-        /* Remove current gap. */
-        auto gap_start = buffer.begin() + gap_pos;
-        std::shift_left(gap_start, buffer.end(), gap_len);
+    return metadata.line_of_offset(std::clamp(offset, 0, storage->size()));
+}
 
-        /* If the cursor is beyond the gap, then its position has the gap
-        factored into it. Therefore if the gap is removed, we need to adjust
-        the cursor's position to account for the (now removed) gap. */
-        if (buffer_space_cursor_pos > gap_pos)
-            buffer_space_cursor_pos -= gap_len;
+int TextBuffer::get_line_start(int line_num)
+{
+    return metadata.line_start_index(line_num);
+}
 
-        /* Add new gap at new cursor position. */
-        gap_pos = buffer_space_cursor_pos;
-        std::shift_right(buffer.begin() + gap_pos, buffer.end(), gap_len);
-    }
+LineDamage TextBuffer::take_damage()
+{
+    /* Lines found by indexing were drawn as part of the unindexed rest until now. */
+    int indexed_from = metadata.take_indexed_from();
 
-    /* Resize cursor on write. */
-    if (gap_len == 0)
-    {
-        gap_len = GAP_SIZE;
-        buffer.resize(buffer.size() + gap_len);
-        std::shift_right(buffer.begin() + gap_pos, buffer.end(), gap_len);
-    }
+    if (indexed_from != std::numeric_limits<int>::max())
+        add_damage(indexed_from, std::numeric_limits<int>::max());
 
-    debug();
+    return std::exchange(damage, LineDamage());
 }
 
-bool TextBuffer::gap_at_end()
+void TextBuffer::add_damage(int first_line, int last_line)
 {
-    auto gap_end = buffer.begin() + gap_pos + gap_len;
-    return gap_end < buffer.end();
+    damage.first_line = std::min(damage.first_line, first_line);
+    damage.last_line = std::max(damage.last_line, last_line);
 }
 
-int TextBuffer::to_buffer_space(int text_space_pos)
+void TextBuffer::apply_insert(int position, std::string_view text)
 {
-    if (text_space_pos <= gap_pos)
-        return text_space_pos;
+    int line_num = metadata.line_of_offset(position);
+    bool adds_lines = text.find('\n') != std::string_view::npos;
+    add_damage(line_num, adds_lines ? std::numeric_limits<int>::max() : line_num);
 
-    return text_space_pos + gap_len;
+    {
+        TIME_STAGE(tracing::Stage::EDIT);
+        storage->insert(position, text);
+    }
+    {
+        TIME_STAGE(tracing::Stage::METADATA);
+        metadata.insert_text(position, text);
+    }
+
+    TRACE(tracing::Level::DEBUG, "insert %zu bytes at %d", text.size(), position);
 }
 
-int TextBuffer::to_text_space(int buffer_space_pos)
+void TextBuffer::apply_erase(int start, int end)
 {
-    if (buffer_space_pos <= gap_pos)
-        return buffer_space_pos;
-    else if (buffer_space_pos >= gap_pos && buffer_space_pos < gap_pos + gap_len - 1)
-        return gap_pos;
+    int first_line = metadata.line_of_offset(start);
+    bool removes_lines = metadata.line_of_offset(end) != first_line;
+    add_damage(first_line, removes_lines ? std::numeric_limits<int>::max() : first_line);
+
+    {
+        TIME_STAGE(tracing::Stage::EDIT);
+        storage->erase(start, end - start);
+    }
+    {
+        TIME_STAGE(tracing::Stage::METADATA);
+        metadata.erase_text(start, end);
+    }
 
-    return buffer_space_pos - gap_len;
+    TRACE(tracing::Level::DEBUG, "erase [%d, %d)", start, end);
 }
 
-void TextBuffer::debug()
+void TextBuffer::apply_replace(std::span<const Replacement> replacements)
 {
-    std::ofstream debug_file("debug.txt", std::ofstream::out | std::ofstream::trunc);
+    /* Replacements that neither add nor remove lines (e.g. typing at several cursors) only change
+    the lengths of the lines they're on, which is O(log n) each. That beats a full rebuild unless
+    there are replacements on a good fraction of the lines. */
+    std::vector<std::pair<int, int>> line_deltas;
+    bool few_replacements = replacements.size() * LINE_UPDATES_PER_REBUILD < static_cast<std::size_t>(metadata.line_count());
+
+    for (std::size_t i = 0; i < replacements.size() && few_replacements; i++)
+    {
+        const Replacement &replacement = replacements[i];
+        int line_num = metadata.line_of_offset(replacement.index);
+
+        if (replacement.text.find('\n') != std::string_view::npos || metadata.line_of_offset(replacement.index + replacement.length) != line_num)
+        {
+            line_deltas.clear();
+            break;
+        }
 
-    debug_file << "= Cursor = " << std::endl;
-    debug_file << "buffer space cursor pos = " << buffer_space_cursor_pos << ", cursor line = " << current_line << std::endl;
-    debug_file << "text space cursor pos = " << to_text_space(buffer_space_cursor_pos) << std::endl;
-    debug_file << "at: " << buffer[buffer_space_cursor_pos] << std::endl;
+        line_deltas.emplace_back(line_num, static_cast<int>(replacement.text.size()) - replacement.length);
+    }
 
-    debug_file << "\n= Gap = " << std::endl;
-    debug_file << "gap len = " << gap_len << ", gap pos = " << gap_pos << std::endl;
+    bool keeps_lines = !line_deltas.empty();
 
-    debug_file << "\n= Buffer =" << std::endl;
+    /* Otherwise anything from the first replacement on may have moved. */
+    int first_line = metadata.line_of_offset(replacements.front().index);
+    add_damage(first_line, keeps_lines ? line_deltas.back().first : std::numeric_limits<int>::max());
 
-    for (int i = 0; i < buffer.size(); i++)
     {
-        if (i >= gap_pos && i < gap_pos + gap_len)
-        {
-            debug_file << i << ": _ (gap)";
-        }
-        else if (buffer[i] == '\n')
+        TIME_STAGE(tracing::Stage::EDIT);
+        storage->replace(replacements);
+    }
+    {
+        TIME_STAGE(tracing::Stage::METADATA);
+
+        if (keeps_lines)
         {
-            debug_file << i << ": \\n";
+            for (auto [line_num, delta] : line_deltas)
+                metadata.update_line_length(line_num, delta);
         }
         else
         {
-            debug_file << i << ": " << buffer[i];
+            metadata.rebuild(storage->segments());
         }
+    }
+
+    TRACE(tracing::Level::DEBUG, "replace %zu ranges from %d", replacements.size(), replacements.front().index);
+}
 
-        if (i == buffer_space_cursor_pos)
-            debug_file << " (cursor)";
+void TextBuffer::move_cursor_to(int position)
+{
+    cursor_pos = position;
+    current_line = metadata.line_of_offset(cursor_pos);
+}
+
+int TextBuffer::clamp_position(int row, int col)
+{
+    metadata.index_to_line(row);
 
-        debug_file << std::endl;
+    int max_line = metadata.line_count() - 1; // Lines are zero-indexed, so subtract 1
+    int line = std::clamp(row, 0, max_line);
+
+    /* Lines without a newline (i.e. the final line) allow the cursor to move one index beyond the
+    final text index, to allow for inserting at the end of the line. */
+    int selectable_indices = metadata.line_length(line);
+
+    /* Lines with a newline make the cursor stop at the newline (since it's invalid to insert
+    characters after a newline on a single line), and so subtract one from the line length to
+    account for the newline. */
+    if (!metadata.line_is_final(line))
+        selectable_indices--;
+
+    int offset = std::min(col, selectable_indices);
+    return metadata.line_start_index(line) + std::max(0, offset);
+}
+
+void TextBuffer::edit_at_cursors(std::string_view text, int erase_len)
+{
+    std::vector<int> cursors = extra_cursors;
+    cursors.insert(std::lower_bound(cursors.begin(), cursors.end(), cursor_pos), cursor_pos);
+
+    std::vector<Replacement> replacements;
+    replacements.reserve(cursors.size());
+
+    int previous = 0;
+
+    for (int cursor : cursors)
+    {
+        int start = std::max(cursor - erase_len, previous);
+        previous = cursor;
+
+        if (start < cursor || !text.empty())
+            replacements.push_back(Replacement{start, cursor - start, text});
+    }
+
+    replace(replacements);
+}
+
+void TextBuffer::map_positions(std::vector<int> &positions, std::span<const Replacement> replacements)
+{
+    std::size_t next = 0;
+    int shift = 0;
+
+    for (int &position : positions)
+    {
+        /* Take in every replacement that ends at or before the position. */
+        while (next < replacements.size())
+        {
+            const Replacement &replacement = replacements[next];
+            bool before = replacement.index < position || (replacement.index == position && replacement.length == 0);
+
+            if (!before || replacement.index + replacement.length > position)
+                break;
+
+            shift += static_cast<int>(replacement.text.size()) - replacement.length;
+            next++;
+        }
+
+        if (next < replacements.size() && replacements[next].index < position && replacements[next].index + replacements[next].length > position)
+            position = replacements[next].index + shift;
+        else
+            position += shift;
     }
+}
+
+void TextBuffer::normalise_cursors()
+{
+    std::sort(extra_cursors.begin(), extra_cursors.end());
+    extra_cursors.erase(std::unique(extra_cursors.begin(), extra_cursors.end()), extra_cursors.end());
+
+    auto main_cursor = std::lower_bound(extra_cursors.begin(), extra_cursors.end(), cursor_pos);
+
+    if (main_cursor != extra_cursors.end() && *main_cursor == cursor_pos)
+        extra_cursors.erase(main_cursor);
+}
+
+void TextBuffer::dump(std::ostream &os)
+{
+    os << "= Cursor = " << std::endl;
+    os << "cursor pos = " << cursor_pos << ", cursor line = " << current_line << std::endl;
+
+    if (cursor_pos < storage->size())
+        os << "at: " << storage->at(cursor_pos) << std::endl;
+
+    os << std::endl;
+    storage->debug(os);
 
-    debug_file << "\n= Line Info =" << std::endl;
+    os << "\n= Line Info =" << std::endl;
 
-    debug_file << metadata;
+    os << metadata;
 }
@@ -1,99 +1,298 @@
 #include "text_buffer/TextMetadata.h"
+#include "text_buffer/NewlineScan.h"
 
 #include <algorithm>
+#include <utility>
 
 TextMetadata::TextMetadata()
 {
-    line_data.push_back(LineMetadata{0, 0, true});
+    line_data.insert(0, LineMetadata{0});
 }
 
 void TextMetadata::split_line(int line_num, int index)
 {
+    index_to_line(line_num);
+
     if (line_num >= line_data.size())
         return;
 
     /* Create new line. */
-    LineMetadata new_line;
-    new_line.start_index = line_data[line_num].start_index + index;
-    new_line.length = line_data[line_num].length - index;
-    new_line.final_line = line_data[line_num].final_line;
-
-    line_data.insert(line_data.begin() + line_num + 1, new_line);
+    int line_length = line_data.at(line_num).length;
+    line_data.insert(line_num + 1, LineMetadata{line_length - index});
 
     /* Update existing line. */
-    line_data[line_num].length -= new_line.length;
-    line_data[line_num].final_line = false;
+    line_data.set(line_num, LineMetadata{index});
 }
 
 void TextMetadata::merge_line(int line_num)
 {
-    if (line_num >= line_data.size())
+    index_to_line(line_num);
+
+    if (line_num <= 0 || line_num >= line_data.size())
         return;
 
-    line_data[line_num - 1].length += line_data[line_num].length;
-    line_data[line_num - 1].final_line = line_data[line_num].final_line;
-    line_data.erase(line_data.begin() + line_num);
+    line_data.add_length(line_num - 1, line_data.at(line_num).length);
+    line_data.erase(line_num);
 }
 
 void TextMetadata::update_line_length(int line_num, int delta)
 {
+    index_to_line(line_num);
+
     if (line_num >= line_data.size())
         return;
 
-    line_data[line_num].length += delta;
-
-    update_indexes(line_num + 1, delta);
+    line_data.add_length(line_num, delta);
 }
 
-void TextMetadata::update_indexes(int start_line_num, int delta)
+void TextMetadata::insert_text(int index, std::string_view text)
 {
-    auto start_itr = line_data.begin() + start_line_num;
+    index_to_offset(index);
 
-    if (start_itr >= line_data.end())
+    int line_num = line_of_offset(index);
+
+    /* Most inserts (e.g. typing) don't add any lines, so avoid scanning for them properly. */
+    if (text.find('\n') == std::string_view::npos)
+    {
+        line_data.add_length(line_num, static_cast<int>(text.size()));
         return;
+    }
+
+    std::vector<int> newlines = find_newlines(text);
+
+    int relative_index = index - line_data.prefix_length(line_num);
+    int remaining_len = line_data.at(line_num).length - relative_index;
+
+    /* The line is cut at the insert point. Its first part runs up to the text's first newline, the
+    text's other newlines each end a new line, and the final new line takes the rest of the text
+    plus what was left of the original line. */
+    std::vector<LineMetadata> new_lines;
+    new_lines.reserve(newlines.size());
 
-    std::for_each(start_itr, line_data.end(), [delta](LineMetadata &l)
-                  { l.start_index += delta; });
+    for (std::size_t i = 1; i < newlines.size(); i++)
+        new_lines.push_back(LineMetadata{newlines[i] - newlines[i - 1]});
+
+    new_lines.push_back(LineMetadata{static_cast<int>(text.size()) - newlines.back() - 1 + remaining_len});
+
+    line_data.set(line_num, LineMetadata{relative_index + newlines.front() + 1});
+    line_data.insert(line_num + 1, std::span<const LineMetadata>(new_lines));
+}
+
+void TextMetadata::erase_text(int start, int end)
+{
+    if (start >= end)
+        return;
+
+    index_to_offset(end);
+
+    int first_line = line_of_offset(start);
+    int last_line = line_of_offset(end);
+
+    /* The first line keeps the part before the erased text, and gains whatever is left of the last
+    line after it. */
+    int kept_before = start - line_data.prefix_length(first_line);
+    int kept_after = line_data.prefix_length(last_line) + line_data.at(last_line).length - end;
+
+    line_data.set(first_line, LineMetadata{kept_before + kept_after});
+    line_data.erase(first_line + 1, last_line + 1);
 }
 
 void TextMetadata::clear()
 {
+    indexer.reset();
+    line_data.clear();
+    line_data.insert(0, LineMetadata{0});
+}
+
+void TextMetadata::rebuild(std::string_view text)
+{
+    indexer.reset();
+
+    std::vector<LineMetadata> lines;
+    std::vector<int> newlines;
+    int line_start = 0;
+
+    scan_lines(std::span<const char>(text.data(), text.size()), 0, line_start, lines, newlines);
+
+    /* The final line has no newline, and is empty if the text ends with one. */
+    lines.push_back(LineMetadata{static_cast<int>(text.size()) - line_start});
+
+    line_data.assign(lines);
+}
+
+void TextMetadata::rebuild(std::span<const std::span<const char>> segments)
+{
+    indexer.reset();
+
+    std::vector<LineMetadata> lines;
+    std::vector<int> newlines;
+    int line_start = 0;
+    int segment_start = 0;
+
+    for (std::span<const char> segment : segments)
+    {
+        scan_lines(segment, segment_start, line_start, lines, newlines);
+        segment_start += static_cast<int>(segment.size());
+    }
+
+    lines.push_back(LineMetadata{segment_start - line_start});
+
+    line_data.assign(lines);
+}
+
+void TextMetadata::rebuild_lazily(std::string_view text, std::shared_ptr<const void> owner)
+{
+    /* Stop the old indexer before its lines are thrown away. */
+    indexer.reset();
+
     line_data.clear();
-    line_data.push_back(LineMetadata{0, 0, true});
+    line_data.insert(0, LineMetadata{static_cast<int>(text.size())});
+
+    unindexed_start = 0;
+    indexed_from = 0;
+
+    if (!text.empty())
+        indexer = std::make_unique<LineIndexer>(text, std::move(owner));
+}
+
+bool TextMetadata::is_complete()
+{
+    return indexer == nullptr;
+}
+
+void TextMetadata::index_to_line(int line_num)
+{
+    /* The final line is the unindexed rest, so isn't a line yet. */
+    while (indexer != nullptr && line_num >= line_data.size() - 1)
+        index_chunk();
+}
+
+bool TextMetadata::poll_index()
+{
+    bool indexed = false;
+
+    for (int i = 0; i < CHUNKS_PER_POLL && indexer != nullptr && indexer->ready(); i++)
+    {
+        index_chunk();
+        indexed = true;
+    }
+
+    return indexed;
+}
+
+int TextMetadata::take_indexed_from()
+{
+    return std::exchange(indexed_from, std::numeric_limits<int>::max());
+}
+
+void TextMetadata::index_to_offset(int index)
+{
+    while (indexer != nullptr && index >= line_data.prefix_length(line_data.size() - 1))
+        index_chunk();
+}
+
+void TextMetadata::index_chunk()
+{
+    int chunk_start = static_cast<int>(indexer->next_chunk_start());
+    std::vector<int> newlines = indexer->take();
+
+    if (!newlines.empty())
+    {
+        std::vector<LineMetadata> lines;
+        lines.reserve(newlines.size());
+
+        int line_start = unindexed_start;
+
+        for (int newline : newlines)
+        {
+            int line_end = chunk_start + newline + 1;
+
+            lines.push_back(LineMetadata{line_end - line_start});
+            line_start = line_end;
+        }
+
+        /* The new lines are split off the front of the unindexed rest. */
+        int final_line = line_data.size() - 1;
+
+        line_data.add_length(final_line, unindexed_start - line_start);
+        line_data.insert(final_line, std::span<const LineMetadata>(lines));
+
+        unindexed_start = line_start;
+        indexed_from = std::min(indexed_from, final_line);
+    }
+
+    /* What's left is the real final line. */
+    if (indexer->finished())
+        indexer.reset();
 }
 
 int TextMetadata::line_start_index(int line_num)
 {
+    index_to_line(line_num);
+
     if (line_num >= line_data.size())
         return -1;
 
-    return line_data[line_num].start_index;
+    return line_data.prefix_length(line_num);
 }
 
 int TextMetadata::line_length(int line_num)
 {
+    index_to_line(line_num);
+
     if (line_num < 0 || line_num >= line_data.size())
         return 0;
 
-    return line_data[line_num].length;
+    return line_data.at(line_num).length;
 }
 
 int TextMetadata::line_count()
 {
-    return static_cast<int>(line_data.size());
+    return line_data.size();
 }
 
 bool TextMetadata::line_is_final(int line_num)
 {
-    return line_data[line_num].final_line;
+    index_to_line(line_num);
+
+    /* Only the final line lacks a newline. */
+    return line_num == line_data.size() - 1;
+}
+
+int TextMetadata::line_of_offset(int index)
+{
+    index_to_offset(index);
+
+    return line_data.find(index).first;
 }
 
-std::ostream &operator<<(std::ostream &os, TextMetadata tm)
+void TextMetadata::scan_lines(std::span<const char> segment, int segment_start, int &line_start, std::vector<LineMetadata> &lines, std::vector<int> &newlines)
 {
-    for (auto &line : tm.line_data)
+    /* Scan in chunks, so the positions scratch buffer stays small however large the text is. */
+    constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+    newlines.resize(std::max(newlines.size(), std::min(segment.size(), CHUNK_SIZE)));
+
+    for (std::size_t chunk_start = 0; chunk_start < segment.size(); chunk_start += CHUNK_SIZE)
     {
-        os << "start index = " << line.start_index << ", length = " << line.length << ", final line = " << line.final_line << std::endl;
+        std::size_t chunk_size = std::min(CHUNK_SIZE, segment.size() - chunk_start);
+        std::size_t newline_count = find_newlines(segment.data() + chunk_start, chunk_size, newlines.data());
+
+        for (std::size_t i = 0; i < newline_count; i++)
+        {
+            int line_end = segment_start + static_cast<int>(chunk_start) + newlines[i] + 1;
+
+            lines.push_back(LineMetadata{line_end - line_start});
+            line_start = line_end;
+        }
     }
+}
+
+std::ostream &operator<<(std::ostream &os, const TextMetadata &tm)
+{
+    int final_line = tm.line_data.size() - 1;
+
+    tm.line_data.for_each([&os, final_line](int line_num, int start_index, const LineMetadata &line)
+                          { os << "start index = " << start_index << ", length = " << line.length << ", final line = " << (line_num == final_line) << std::endl; });
 
     return os;
 }
@@ -0,0 +1,431 @@
+#include "text_buffer/TextSearch.h"
+
+#include <tracing/Trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <utility>
+
+struct TextSearch::Search
+{
+    /* A contiguous part of the snapshot, and where it starts in the text. */
+    struct Segment
+    {
+        std::size_t start;
+        const char *data;
+        std::size_t size;
+    };
+
+    std::shared_ptr<const TextSnapshot> snapshot;
+    std::vector<Segment> segments;
+    std::size_t total = 0;
+
+    std::string pattern;
+    SearchMode mode;
+    std::regex regex;
+
+    std::size_t start_offset;
+
+    /* The ranges matches are looked for in, in the order they're handed out. Literal matches belong
+    to the chunk they start in, and regex matches to the chunk their line starts in. */
+    std::vector<std::pair<std::size_t, std::size_t>> chunks;
+
+    std::atomic<std::size_t> next_chunk = 0;
+    std::atomic<std::size_t> bytes_scanned = 0;
+    std::atomic<bool> cancelled = false;
+
+    /* Everything below is guarded by TextSearch::mutex. */
+    int scanners_running = 0;
+    std::size_t chunks_finished = 0;
+    std::size_t match_count = 0;
+    std::vector<SearchMatch> unclaimed;
+
+    /* The matches kept so far, by the offset of the chunk they're in, so that once there are too
+    many the last ones in the text can be dropped (whether taken yet or not). */
+    std::map<std::size_t, std::vector<SearchMatch>> kept;
+    std::size_t matches_kept = 0;
+    std::size_t kept_until = 0;
+
+    /* Finding the first match means knowing each chunk's first match, and which chunks (in order)
+    are done. The first chunk can hold matches from before the start offset too (on the start line
+    of a regex search), which only count once every other chunk has none. */
+    std::vector<bool> chunk_done;
+    std::vector<std::optional<SearchMatch>> chunk_first;
+    std::optional<SearchMatch> wrapped_first;
+    std::size_t settled = 0;
+    std::optional<SearchMatch> first_match;
+
+    std::size_t segment_of(std::size_t offset) const
+    {
+        auto after = std::upper_bound(segments.begin(), segments.end(), offset, [](std::size_t offset, const Segment &segment)
+                                      { return offset < segment.start; });
+
+        return after == segments.begin() ? 0 : after - segments.begin() - 1;
+    }
+
+    char at(std::size_t offset) const
+    {
+        const Segment &segment = segments[segment_of(offset)];
+        return segment.data[offset - segment.start];
+    }
+
+    /* Returns the offset of the first c at or after offset and before limit, or limit if there
+    isn't one. */
+    std::size_t find_byte(std::size_t offset, char c, std::size_t limit) const
+    {
+        for (std::size_t seg = segment_of(offset); seg < segments.size() && segments[seg].start < limit; seg++)
+        {
+            const Segment &segment = segments[seg];
+            std::size_t from = std::max(offset, segment.start) - segment.start;
+            std::size_t to = std::min(limit - segment.start, segment.size);
+
+            if (from >= to)
+                continue;
+
+            const void *found = std::memchr(segment.data + from, c, to - from);
+
+            if (found != nullptr)
+                return segment.start + (static_cast<const char *>(found) - segment.data);
+        }
+
+        return limit;
+    }
+
+    /* Returns the offset of the start of the line containing offset. */
+    std::size_t line_start(std::size_t offset) const
+    {
+        for (std::size_t seg = segment_of(offset) + 1; seg-- > 0;)
+        {
+            const Segment &segment = segments[seg];
+            std::size_t before = std::min(offset, segment.start + segment.size) - segment.start;
+            std::size_t newline = std::string_view(segment.data, before).rfind('\n');
+
+            if (newline != std::string_view::npos)
+                return segment.start + newline + 1;
+        }
+
+        return 0;
+    }
+
+    /* Whether the pattern occurs at pos in the segment seg, carrying on into the following segments
+    if it runs off the end. */
+    bool matches_at(std::size_t seg, std::size_t pos) const
+    {
+        std::size_t matched = 0;
+
+        for (; matched < pattern.size() && seg < segments.size(); seg++, pos = 0)
+        {
+            const Segment &segment = segments[seg];
+            std::size_t length = std::min(pattern.size() - matched, segment.size - pos);
+
+            if (std::memcmp(segment.data + pos, pattern.data() + matched, length) != 0)
+                return false;
+
+            matched += length;
+        }
+
+        return matched == pattern.size();
+    }
+
+    void scan_literal(std::size_t begin, std::size_t end, std::vector<SearchMatch> &matches) const
+    {
+        const char first = pattern[0];
+
+        for (std::size_t seg = segment_of(begin); seg < segments.size() && segments[seg].start < end; seg++)
+        {
+            const Segment &segment = segments[seg];
+
+            const char *p = segment.data + (std::max(begin, segment.start) - segment.start);
+            const char *stop = segment.data + (std::min(end, segment.start + segment.size) - segment.start);
+
+            /* memchr() skips to each candidate a vector at a time, so most of the text is never
+            looked at a byte at a time. */
+            while (p < stop && (p = static_cast<const char *>(std::memchr(p, first, stop - p))) != nullptr)
+            {
+                std::size_t pos = p - segment.data;
+
+                if (matches_at(seg, pos))
+                    matches.push_back(SearchMatch{segment.start + pos, pattern.size()});
+
+                p++;
+            }
+        }
+    }
+
+    void scan_regex(std::size_t begin, std::size_t end, std::vector<SearchMatch> &matches, std::string &scratch) const
+    {
+        /* Lines belong to the chunk they start in, so skip the rest of one that started before.
+        The skip stops at the end of the chunk, as otherwise every chunk of a file with very long
+        lines (or none at all) would read on to the end of the text. */
+        std::size_t line = begin;
+
+        if (line > 0 && at(line - 1) != '\n')
+        {
+            std::size_t newline = find_byte(line, '\n', end);
+            line = newline < end ? newline + 1 : end;
+        }
+
+        while (line < end && line < total && !cancelled.load(std::memory_order_relaxed))
+        {
+            std::size_t line_end = find_byte(line, '\n', total);
+
+            /* Lines are matched in place, unless they're split across segments. */
+            const Segment &segment = segments[segment_of(line)];
+            const char *text = segment.data + (line - segment.start);
+
+            if (line_end > segment.start + segment.size)
+            {
+                scratch.clear();
+
+                for (std::size_t seg = segment_of(line); seg < segments.size() && segments[seg].start < line_end; seg++)
+                {
+                    std::size_t from = std::max(line, segments[seg].start) - segments[seg].start;
+                    std::size_t to = std::min(line_end, segments[seg].start + segments[seg].size) - segments[seg].start;
+
+                    scratch.append(segments[seg].data + from, to - from);
+                }
+
+                text = scratch.data();
+            }
+
+            for (std::cregex_iterator match(text, text + (line_end - line), regex), last; match != last; ++match)
+            {
+                /* Empty matches (e.g. of "x*") can't be found in any useful sense. */
+                if (match->length() > 0)
+                    matches.push_back(SearchMatch{line + static_cast<std::size_t>(match->position()), static_cast<std::size_t>(match->length())});
+            }
+
+            line = line_end + 1;
+        }
+    }
+};
+
+TextSearch::TextSearch(int thread_count) : pool(thread_count) {};
+
+TextSearch::~TextSearch()
+{
+    cancel();
+}
+
+bool TextSearch::start(std::shared_ptr<const TextSnapshot> snapshot, const std::string &pattern, SearchMode mode, std::size_t start_offset)
+{
+    cancel();
+
+    if (pattern.empty())
+        return false;
+
+    std::shared_ptr<Search> search = std::make_shared<Search>();
+    search->pattern = pattern;
+    search->mode = mode;
+
+    if (mode == SearchMode::REGEX)
+    {
+        try
+        {
+            search->regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+        }
+        catch (const std::regex_error &)
+        {
+            TRACE(tracing::Level::INFO, "invalid search regex %s", pattern.c_str());
+            return false;
+        }
+    }
+
+    /* Only the segment list is built here, which is O(pieces). The text itself is only read by the
+    scanners. */
+    snapshot->for_each_segment([&](std::span<const char> segment)
+                               {
+                                   if (!segment.empty())
+                                       search->segments.push_back(Search::Segment{search->total, segment.data(), segment.size()});
+
+                                   search->total += segment.size(); });
+
+    search->snapshot = std::move(snapshot);
+    search->start_offset = start_offset < search->total ? start_offset : 0;
+    search->kept_until = search->total;
+
+    /* Chunks are aligned, except for the first, which starts at the start offset (or, for a regex,
+    the start of its line, so that the line isn't split), and the last, which wraps back around to
+    just before it. */
+    std::size_t first_begin = mode == SearchMode::REGEX && search->total > 0 ? search->line_start(search->start_offset) : search->start_offset;
+    std::size_t aligned = first_begin / CHUNK_SIZE * CHUNK_SIZE;
+
+    if (search->total > 0)
+        search->chunks.emplace_back(first_begin, std::min(aligned + CHUNK_SIZE, search->total));
+
+    for (std::size_t begin = aligned + CHUNK_SIZE; begin < search->total; begin += CHUNK_SIZE)
+        search->chunks.emplace_back(begin, std::min(begin + CHUNK_SIZE, search->total));
+
+    for (std::size_t begin = 0; begin < aligned; begin += CHUNK_SIZE)
+        search->chunks.emplace_back(begin, begin + CHUNK_SIZE);
+
+    if (first_begin > aligned)
+        search->chunks.emplace_back(aligned, first_begin);
+
+    search->chunk_done.resize(search->chunks.size());
+    search->chunk_first.resize(search->chunks.size());
+
+    TRACE(tracing::Level::INFO, "search for %s in %zu bytes, %zu chunks", pattern.c_str(), search->total, search->chunks.size());
+
+    int scanner_count = std::min(pool.size(), static_cast<int>(search->chunks.size()));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = search;
+        search->scanners_running = scanner_count;
+    }
+
+    for (int i = 0; i < scanner_count; i++)
+        pool.submit([this, search]
+                    { scan(search); });
+
+    return true;
+}
+
+void TextSearch::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (current == nullptr)
+        return;
+
+    current->cancelled = true;
+    current = nullptr;
+}
+
+void TextSearch::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    search_finished.wait(lock, [this]
+                         { return current == nullptr || current->scanners_running == 0; });
+}
+
+std::vector<SearchMatch> TextSearch::take_matches()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (current == nullptr)
+        return {};
+
+    return std::exchange(current->unclaimed, {});
+}
+
+SearchStatus TextSearch::status()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    SearchStatus status;
+
+    if (current == nullptr)
+        return status;
+
+    status.searching = current->chunks_finished < current->chunks.size();
+    status.bytes_scanned = current->bytes_scanned.load(std::memory_order_relaxed);
+    status.bytes_total = current->total;
+    status.match_count = current->match_count;
+    status.kept_until = current->kept_until;
+    status.first_match = current->first_match;
+
+    return status;
+}
+
+void TextSearch::scan(const std::shared_ptr<Search> &search)
+{
+    std::vector<SearchMatch> matches;
+    std::string scratch;
+
+    while (!search->cancelled.load(std::memory_order_relaxed))
+    {
+        std::size_t chunk = search->next_chunk.fetch_add(1, std::memory_order_relaxed);
+
+        if (chunk >= search->chunks.size())
+            break;
+
+        auto [begin, end] = search->chunks[chunk];
+
+        if (search->mode == SearchMode::REGEX)
+            search->scan_regex(begin, end, matches, scratch);
+        else
+            search->scan_literal(begin, end, matches);
+
+        search->bytes_scanned.fetch_add(end - begin, std::memory_order_relaxed);
+
+        finish_chunk(*search, chunk, matches);
+        matches.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (--search->scanners_running == 0)
+        search_finished.notify_all();
+}
+
+void TextSearch::finish_chunk(Search &search, std::size_t chunk, std::vector<SearchMatch> &matches)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    /* Cancelled searches have nobody left to take their matches. */
+    if (search.cancelled.load(std::memory_order_relaxed))
+        return;
+
+    search.chunks_finished++;
+    search.chunk_done[chunk] = true;
+    search.match_count += matches.size();
+
+    keep_matches(search, chunk, matches);
+
+    for (const SearchMatch &match : matches)
+    {
+        if (chunk != 0 || match.offset >= search.start_offset)
+        {
+            search.chunk_first[chunk] = match;
+            break;
+        }
+
+        if (!search.wrapped_first)
+            search.wrapped_first = match;
+    }
+
+    while (!search.first_match && search.settled < search.chunks.size() && search.chunk_done[search.settled])
+        search.first_match = search.chunk_first[search.settled++];
+
+    if (!search.first_match && search.settled == search.chunks.size())
+        search.first_match = search.wrapped_first;
+}
+
+void TextSearch::keep_matches(Search &search, std::size_t chunk, const std::vector<SearchMatch> &matches)
+{
+    auto kept_end = std::lower_bound(matches.begin(), matches.end(), search.kept_until, [](const SearchMatch &match, std::size_t offset)
+                                     { return match.offset < offset; });
+
+    if (kept_end == matches.begin())
+        return;
+
+    search.kept.emplace(search.chunks[chunk].first, std::vector<SearchMatch>(matches.begin(), kept_end));
+    search.unclaimed.insert(search.unclaimed.end(), matches.begin(), kept_end);
+    search.matches_kept += kept_end - matches.begin();
+
+    if (search.matches_kept <= MAX_MATCHES)
+        return;
+
+    /* Drop the last matches in the text, so that what's kept is always everything up to a point. */
+    while (search.matches_kept > MAX_MATCHES)
+    {
+        std::vector<SearchMatch> &last = std::prev(search.kept.end())->second;
+        std::size_t drop = std::min(last.size(), search.matches_kept - MAX_MATCHES);
+
+        search.kept_until = last[last.size() - drop].offset;
+        search.matches_kept -= drop;
+        last.resize(last.size() - drop);
+
+        if (last.empty())
+            search.kept.erase(std::prev(search.kept.end()));
+    }
+
+    std::erase_if(search.unclaimed, [&search](const SearchMatch &match)
+                  { return match.offset >= search.kept_until; });
+}
@@ -0,0 +1,51 @@
+#include "text_buffer/TextView.h"
+
+#include <algorithm>
+#include <cstring>
+
+TextView::TextView(TextStorage *storage, int start, int length) : storage(storage), start(start), length(std::max(length, 0)) {};
+
+char TextView::at(int index) const
+{
+    return storage->at(start + index);
+}
+
+TextView TextView::substr(int sub_start, int sub_length) const
+{
+    sub_start = std::clamp(sub_start, 0, length);
+    sub_length = std::clamp(sub_length, 0, length - sub_start);
+
+    return TextView(storage, start + sub_start, sub_length);
+}
+
+void TextView::copy_to(std::string &out) const
+{
+    out.clear();
+
+    for_each_segment([&out](std::span<const char> segment)
+                     { out.append(segment.data(), segment.size()); });
+}
+
+std::string TextView::to_string() const
+{
+    std::string text;
+    text.reserve(length);
+    copy_to(text);
+    return text;
+}
+
+bool TextView::operator==(std::string_view text) const
+{
+    if (static_cast<int>(text.size()) != length)
+        return false;
+
+    bool equal = true;
+    int offset = 0;
+
+    for_each_segment([&](std::span<const char> segment)
+                     {
+                         equal = equal && std::memcmp(segment.data(), text.data() + offset, segment.size()) == 0;
+                         offset += static_cast<int>(segment.size()); });
+
+    return equal;
+}
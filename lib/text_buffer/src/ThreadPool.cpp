@@ -0,0 +1,64 @@
+#include "text_buffer/ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int thread_count)
+{
+    if (thread_count <= 0)
+        thread_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    threads.reserve(thread_count);
+
+    for (int i = 0; i < thread_count; i++)
+        threads.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+
+    task_queued.notify_all();
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+
+    task_queued.notify_one();
+}
+
+int ThreadPool::size() const
+{
+    return static_cast<int>(threads.size());
+}
+
+void ThreadPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        task_queued.wait(lock, [this]
+                         { return !tasks.empty() || stopping; });
+
+        if (stopping)
+            return;
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,244 @@
+#include "text_buffer/UndoHistory.h"
+
+#include <algorithm>
+
+/* Blocks are only freed whole, so they need to be a small fraction of the limit for it to be kept
+to closely, however small it is. */
+UndoHistory::UndoHistory(std::size_t memory_limit)
+    : memory_limit(memory_limit), arena(std::clamp<std::size_t>(memory_limit / 16, 64, TextArena::DEFAULT_BLOCK_SIZE)) {};
+
+void UndoHistory::record_insert(int position, std::string_view text, int cursor_before)
+{
+    if (text.empty())
+        return;
+
+    discard_redo();
+
+    if (!fits(text.size()))
+    {
+        clear();
+        return;
+    }
+
+    std::string_view stored = arena.append(text);
+
+    /* Typing carries on from the end of the current run, unless it's a new line. */
+    if (!sealed && !records.empty() && text.size() == 1 && text[0] != '\n')
+    {
+        const Record &last = records.back();
+
+        if (last.kind == EditKind::INSERT && last.position + last.length == position && last.text[last.length - 1] != '\n' && extend(stored))
+        {
+            enforce_limit();
+            return;
+        }
+    }
+
+    push(EditKind::INSERT, position, stored, cursor_before);
+}
+
+void UndoHistory::record_erase(int position, std::string_view text, int cursor_before)
+{
+    if (text.empty())
+        return;
+
+    discard_redo();
+
+    if (!fits(text.size()))
+    {
+        clear();
+        return;
+    }
+
+    std::string_view stored = arena.append(text);
+
+    if (!sealed && !records.empty() && text.size() == 1 && records.back().kind == EditKind::ERASE)
+    {
+        Record &last = records.back();
+
+        /* Backspace, i.e. erasing the character just before the previous one. */
+        bool backward = position + 1 == last.position && (last.reversed || last.length == 1);
+
+        /* Delete, i.e. erasing the character that took the previous one's place. */
+        bool forward = position == last.position && !last.reversed;
+
+        if ((backward || forward) && extend(stored))
+        {
+            if (backward)
+            {
+                last.position = position;
+                last.reversed = true;
+            }
+
+            enforce_limit();
+            return;
+        }
+    }
+
+    push(EditKind::ERASE, position, stored, cursor_before);
+}
+
+void UndoHistory::record_replace(std::span<const Replacement> replacements, std::string_view replaced, int cursor_before)
+{
+    discard_redo();
+
+    std::string text(replaced);
+    std::vector<ReplacedSpan> spans;
+    spans.reserve(replacements.size());
+
+    for (const Replacement &replacement : replacements)
+    {
+        spans.push_back(ReplacedSpan{replacement.index, replacement.length, static_cast<int>(replacement.text.size())});
+        text.append(replacement.text);
+    }
+
+    /* Replacing nothing with nothing doesn't change anything, so there's nothing to undo. */
+    if (text.empty())
+        return;
+
+    if (!fits(text.size() + spans.size() * sizeof(ReplacedSpan)))
+    {
+        clear();
+        return;
+    }
+
+    int position = spans.front().position;
+    push(EditKind::REPLACE, position, arena.append(text), cursor_before, std::move(spans));
+}
+
+void UndoHistory::seal()
+{
+    sealed = true;
+}
+
+std::optional<UndoEdit> UndoHistory::undo()
+{
+    sealed = true;
+
+    if (done_count == 0)
+        return std::nullopt;
+
+    return to_edit(records[--done_count]);
+}
+
+std::optional<UndoEdit> UndoHistory::redo()
+{
+    sealed = true;
+
+    if (done_count == records.size())
+        return std::nullopt;
+
+    return to_edit(records[done_count++]);
+}
+
+bool UndoHistory::can_undo() const
+{
+    return done_count > 0;
+}
+
+bool UndoHistory::can_redo() const
+{
+    return done_count < records.size();
+}
+
+bool UndoHistory::fits(std::size_t length) const
+{
+    return length + sizeof(Record) <= memory_limit;
+}
+
+void UndoHistory::clear()
+{
+    records.clear();
+    arena.clear();
+    span_memory = 0;
+
+    done_count = 0;
+    sealed = true;
+}
+
+std::size_t UndoHistory::memory_usage() const
+{
+    return arena.memory_usage() + records.size() * sizeof(Record) + span_memory;
+}
+
+void UndoHistory::discard_redo()
+{
+    for (auto record = records.begin() + done_count; record != records.end(); ++record)
+        span_memory -= record->spans.size() * sizeof(ReplacedSpan);
+
+    records.erase(records.begin() + done_count, records.end());
+}
+
+void UndoHistory::enforce_limit()
+{
+    while (!records.empty() && memory_usage() > memory_limit)
+    {
+        span_memory -= records.front().spans.size() * sizeof(ReplacedSpan);
+        records.pop_front();
+        done_count--;
+
+        if (!records.empty())
+            arena.release_front(records.front().text);
+    }
+
+    /* Only possible if a single edit was too big to keep, and then there's nothing left to undo. */
+    if (records.empty())
+        clear();
+}
+
+bool UndoHistory::extend(std::string_view stored)
+{
+    Record &last = records.back();
+
+    if (last.text + last.length != stored.data())
+        return false;
+
+    last.length += static_cast<int>(stored.size());
+    return true;
+}
+
+void UndoHistory::push(EditKind kind, int position, std::string_view stored, int cursor_before, std::vector<ReplacedSpan> spans)
+{
+    span_memory += spans.size() * sizeof(ReplacedSpan);
+
+    records.push_back(Record{kind, position, static_cast<int>(stored.size()), cursor_before, stored.data(), false, std::move(spans)});
+    done_count++;
+    sealed = false;
+
+    enforce_limit();
+}
+
+std::string UndoHistory::text_of(const Record &record) const
+{
+    std::string text(record.text, record.length);
+
+    if (record.reversed)
+        std::reverse(text.begin(), text.end());
+
+    return text;
+}
+
+UndoEdit UndoHistory::to_edit(const Record &record) const
+{
+    if (record.kind != EditKind::REPLACE)
+        return UndoEdit{record.kind, record.position, text_of(record), record.cursor_before};
+
+    UndoEdit edit{record.kind, record.position, "", record.cursor_before};
+    edit.replacements.reserve(record.spans.size());
+
+    const char *before = record.text;
+    const char *after = record.text;
+
+    for (const ReplacedSpan &span : record.spans)
+        after += span.before_length;
+
+    for (const ReplacedSpan &span : record.spans)
+    {
+        edit.replacements.push_back(ReplacedText{span.position, std::string(before, span.before_length), std::string(after, span.after_length)});
+
+        before += span.before_length;
+        after += span.after_length;
+    }
+
+    return edit;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+
+/* A minimal assertion for the tests, which (unlike assert()) isn't compiled out of release builds,
+and carries on after a failure so that a run reports all of them. Tests return check_result() from
+main(). */
+namespace test
+{
+    inline int failures = 0;
+
+    inline void check(bool passed, const char *condition, const char *file, int line)
+    {
+        if (passed)
+            return;
+
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+        failures++;
+    }
+
+    inline int check_result()
+    {
+        if (failures > 0)
+            std::fprintf(stderr, "%d checks failed\n", failures);
+
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,204 @@
+#include <text_buffer/TextBuffer.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Check.h"
+
+/* Checks where cursors end up after edits at several cursors at once, especially where one cursor's
+edit reaches another cursor or the range a replacement covers (see TextBuffer::map_positions()). */
+
+namespace
+{
+    std::string text_of(TextBuffer &text)
+    {
+        return text.get_text().to_string();
+    }
+
+    int cursor_of(TextBuffer &text)
+    {
+        return text.get_line_start(text.get_cursor_row()) + text.get_cursor_col();
+    }
+
+    /* Every cursor, the main one included, in order. */
+    std::vector<int> cursors_of(TextBuffer &text)
+    {
+        std::vector<int> cursors = text.get_extra_cursors();
+        cursors.insert(std::lower_bound(cursors.begin(), cursors.end(), cursor_of(text)), cursor_of(text));
+
+        return cursors;
+    }
+
+    /* Makes a single line buffer with the main cursor at main and extra cursors at extras. */
+    void set_up(TextBuffer &text, std::string_view contents, int main, const std::vector<int> &extras)
+    {
+        text.insert(contents);
+        text.set_cursor_pos(0, main);
+
+        for (int extra : extras)
+            text.add_cursor(0, extra);
+    }
+
+    void test_insert_at_every_cursor(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        set_up(text, "abcdef", 3, {0, 6});
+
+        text.insert('X');
+
+        CHECK(text_of(text) == "XabcXdefX");
+        CHECK(cursor_of(text) == 5);
+        CHECK(cursors_of(text) == std::vector<int>({1, 5, 9}));
+    }
+
+    /* Backspacing at adjacent cursors erases one character each, and leaves them all in one place,
+    where they merge into the main cursor. */
+    void test_backspace_merges_adjacent_cursors(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        set_up(text, "abcdef", 3, {1, 2});
+
+        text.pop();
+
+        CHECK(text_of(text) == "def");
+        CHECK(cursor_of(text) == 0);
+        CHECK(text.get_extra_cursors().empty());
+    }
+
+    /* Backspacing at a cursor right after the start of the text erases nothing there, but the
+    cursors after it still move back. */
+    void test_backspace_at_start(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        set_up(text, "abcdef", 4, {0, 2});
+
+        text.pop();
+
+        CHECK(text_of(text) == "acef");
+        CHECK(cursors_of(text) == std::vector<int>({0, 1, 2}));
+    }
+
+    /* A cursor inside a replaced range moves to its start, one at its end stays after the new
+    text, and one after it shifts by the change in length. */
+    void test_replace_over_cursors(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        set_up(text, "0123456789", 5, {2, 6, 8});
+
+        std::vector<Replacement> replacements = {{1, 5, "ab"}};
+        text.replace(replacements);
+
+        CHECK(text_of(text) == "0ab6789");
+        CHECK(cursor_of(text) == 1);
+        CHECK(cursors_of(text) == std::vector<int>({1, 3, 5}));
+    }
+
+    /* An insertion at a cursor pushes it along, but a replacement starting at a cursor doesn't. */
+    void test_edits_starting_at_cursors(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        set_up(text, "hello world", 6, {0});
+
+        std::vector<Replacement> replacements = {{0, 0, "> "}, {6, 5, "there"}};
+        text.replace(replacements);
+
+        CHECK(text_of(text) == "> hello there");
+        CHECK(cursor_of(text) == 8);
+        CHECK(cursors_of(text) == std::vector<int>({2, 8}));
+    }
+
+    /* Compares random typing and backspacing at random cursors against making each cursor's edit
+    one at a time. */
+    void test_against_one_at_a_time(StorageKind kind)
+    {
+        std::mt19937 rng(7);
+
+        for (int round = 0; round < 200; round++)
+        {
+            std::string expected(1 + rng() % 30, 'a');
+
+            for (char &c : expected)
+                c = "abc\n"[rng() % 4];
+
+            TextBuffer text(kind);
+            text.insert(std::string_view(expected));
+            text.set_cursor_pos(0, 0);
+
+            std::vector<int> cursors = {0};
+
+            for (int i = rng() % 6; i > 0; i--)
+            {
+                int position = rng() % (expected.size() + 1);
+                int row = static_cast<int>(std::count(expected.begin(), expected.begin() + position, '\n'));
+                text.add_cursor(row, position - text.get_line_start(row));
+                cursors.push_back(position);
+            }
+
+            std::sort(cursors.begin(), cursors.end());
+            cursors.erase(std::unique(cursors.begin(), cursors.end()), cursors.end());
+
+            for (int step = 0; step < 5; step++)
+            {
+                /* Each cursor's edit is made from the last to the first, so that none of them
+                moves the ones still to be made. */
+                if (rng() % 2 == 0)
+                {
+                    text.insert('x');
+
+                    for (std::size_t i = cursors.size(); i-- > 0;)
+                        expected.insert(cursors[i], 1, 'x');
+
+                    for (std::size_t i = 0; i < cursors.size(); i++)
+                        cursors[i] += static_cast<int>(i) + 1;
+                }
+                else
+                {
+                    text.pop();
+
+                    std::vector<int> starts(cursors.size());
+                    int previous = 0;
+
+                    for (std::size_t i = 0; i < cursors.size(); i++)
+                    {
+                        starts[i] = std::max(cursors[i] - 1, previous);
+                        previous = cursors[i];
+                    }
+
+                    for (std::size_t i = cursors.size(); i-- > 0;)
+                        expected.erase(starts[i], cursors[i] - starts[i]);
+
+                    int erased = 0;
+
+                    for (std::size_t i = 0; i < cursors.size(); i++)
+                    {
+                        erased += cursors[i] - starts[i];
+                        cursors[i] -= erased;
+                    }
+
+                    cursors.erase(std::unique(cursors.begin(), cursors.end()), cursors.end());
+                }
+
+                CHECK(text_of(text) == expected);
+                CHECK(cursors_of(text) == cursors);
+            }
+        }
+    }
+}
+
+int main()
+{
+    for (StorageKind kind : {StorageKind::GAP_BUFFER, StorageKind::PIECE_TABLE})
+    {
+        test_insert_at_every_cursor(kind);
+        test_backspace_merges_adjacent_cursors(kind);
+        test_backspace_at_start(kind);
+        test_replace_over_cursors(kind);
+        test_edits_starting_at_cursors(kind);
+        test_against_one_at_a_time(kind);
+    }
+
+    return test::check_result();
+}
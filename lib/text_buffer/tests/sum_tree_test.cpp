@@ -0,0 +1,150 @@
+#include <text_buffer/SumTree.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+
+/* Checks SumTree's lookups at the edges of items, where an off by one would put an offset in the
+wrong item: item boundaries, zero-length items, and offsets before the start or past the end. */
+
+namespace
+{
+    struct Item
+    {
+        int length;
+    };
+
+    SumTree<Item> make_tree(const std::vector<int> &lengths)
+    {
+        std::vector<Item> items;
+
+        for (int length : lengths)
+            items.push_back(Item{length});
+
+        SumTree<Item> tree;
+        tree.assign(items);
+
+        return tree;
+    }
+
+    void test_empty()
+    {
+        SumTree<Item> tree;
+
+        CHECK(tree.find(0) == std::make_pair(-1, 0));
+        CHECK(tree.prefix_length(0) == 0);
+    }
+
+    void test_prefix_length()
+    {
+        SumTree<Item> tree = make_tree({3, 0, 2, 0, 0, 4});
+
+        std::vector<int> expected = {0, 3, 3, 5, 5, 5, 9};
+
+        for (int index = 0; index <= tree.size(); index++)
+            CHECK(tree.prefix_length(index) == expected[index]);
+    }
+
+    void test_find_at_boundaries()
+    {
+        SumTree<Item> tree = make_tree({3, 0, 2, 0, 0, 4});
+
+        /* An offset at the end of an item is the start of the next non-empty one. */
+        CHECK(tree.find(0) == std::make_pair(0, 0));
+        CHECK(tree.find(2) == std::make_pair(0, 2));
+        CHECK(tree.find(3) == std::make_pair(2, 0));
+        CHECK(tree.find(4) == std::make_pair(2, 1));
+        CHECK(tree.find(5) == std::make_pair(5, 0));
+        CHECK(tree.find(8) == std::make_pair(5, 3));
+
+        /* Offsets outside the text are clamped to its first and final items. */
+        CHECK(tree.find(-1) == std::make_pair(0, 0));
+        CHECK(tree.find(9) == std::make_pair(5, 4));
+        CHECK(tree.find(20) == std::make_pair(5, 15));
+    }
+
+    void test_find_past_trailing_empty_items()
+    {
+        /* The end of the text belongs to the final item, even when it's empty (like the line after
+        a trailing newline). */
+        SumTree<Item> tree = make_tree({2, 0});
+
+        CHECK(tree.find(1) == std::make_pair(0, 1));
+        CHECK(tree.find(2) == std::make_pair(1, 0));
+    }
+
+    /* Compares the tree against a plain vector through a random series of edits, checking every
+    index and offset each time. */
+    void test_against_vector()
+    {
+        std::mt19937 rng(1);
+        SumTree<Item> tree;
+        std::vector<int> lengths;
+
+        for (int step = 0; step < 2000; step++)
+        {
+            int op = rng() % 4;
+            int index = lengths.empty() ? 0 : rng() % (lengths.size() + (op == 0 ? 1 : 0));
+
+            if (op == 0 || lengths.empty())
+            {
+                int length = rng() % 3 == 0 ? 0 : rng() % 5;
+                tree.insert(index, Item{length});
+                lengths.insert(lengths.begin() + index, length);
+            }
+            else if (op == 1)
+            {
+                tree.erase(index);
+                lengths.erase(lengths.begin() + index);
+            }
+            else if (op == 2)
+            {
+                int delta = static_cast<int>(rng() % 3) - lengths[index] % 2;
+                tree.add_length(index, delta);
+                lengths[index] += delta;
+            }
+            else
+            {
+                int length = rng() % 4;
+                tree.set(index, Item{length});
+                lengths[index] = length;
+            }
+
+            CHECK(tree.size() == static_cast<int>(lengths.size()));
+
+            int total = 0;
+
+            for (int i = 0; i < static_cast<int>(lengths.size()); i++)
+            {
+                CHECK(tree.prefix_length(i) == total);
+
+                for (int offset = 0; offset < lengths[i]; offset++)
+                    CHECK(tree.find(total + offset) == std::make_pair(i, offset));
+
+                total += lengths[i];
+            }
+
+            CHECK(tree.prefix_length(static_cast<int>(lengths.size())) == total);
+            CHECK(tree.total_length() == total);
+
+            if (!lengths.empty())
+            {
+                int last = static_cast<int>(lengths.size()) - 1;
+                CHECK(tree.find(total) == std::make_pair(last, total - tree.prefix_length(last)));
+            }
+        }
+    }
+}
+
+int main()
+{
+    test_empty();
+    test_prefix_length();
+    test_find_at_boundaries();
+    test_find_past_trailing_empty_items();
+    test_against_vector();
+
+    return test::check_result();
+}
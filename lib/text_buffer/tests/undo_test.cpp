@@ -0,0 +1,186 @@
+#include <text_buffer/TextBuffer.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Check.h"
+
+/* Checks that undo and redo take a TextBuffer back and forth through exactly the states it went
+through, a run of typing at a time, for both storage backends. */
+
+namespace
+{
+    std::string text_of(TextBuffer &text)
+    {
+        return text.get_text().to_string();
+    }
+
+    int cursor_of(TextBuffer &text)
+    {
+        return text.get_line_start(text.get_cursor_row()) + text.get_cursor_col();
+    }
+
+    void type(TextBuffer &text, std::string_view typed)
+    {
+        for (char c : typed)
+            text.insert(c);
+    }
+
+    /* Typing runs until a newline, so "ab\ncd" is undone as "cd", then the newline, then "ab". */
+    void test_typing_runs(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        type(text, "ab\ncd");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "ab\n");
+        CHECK(cursor_of(text) == 3);
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "ab");
+        CHECK(cursor_of(text) == 2);
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "");
+        CHECK(cursor_of(text) == 0);
+        CHECK(!text.undo());
+
+        CHECK(text.redo());
+        CHECK(text_of(text) == "ab");
+        CHECK(cursor_of(text) == 2);
+
+        CHECK(text.redo());
+        CHECK(text.redo());
+        CHECK(text_of(text) == "ab\ncd");
+        CHECK(cursor_of(text) == 5);
+        CHECK(!text.redo());
+    }
+
+    /* Moving the cursor ends a run, even if typing then carries on where it left off. */
+    void test_cursor_move_ends_run(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        type(text, "abc");
+        text.set_cursor_pos(0, 1);
+        text.set_cursor_pos(0, 3);
+        type(text, "de");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "abc");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "");
+    }
+
+    /* Backspaces coalesce into one erase, which is stored in reverse, so it's worth checking that
+    undo puts the text back the right way round. Deletes (at a fixed position) coalesce too. */
+    void test_erase_runs(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        text.insert(std::string_view("hello world"));
+
+        for (int i = 0; i < 5; i++)
+            text.pop();
+
+        CHECK(text_of(text) == "hello ");
+
+        text.erase(0, 1);
+        text.erase(0, 1);
+        CHECK(text_of(text) == "llo ");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "hello ");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "hello world");
+        CHECK(cursor_of(text) == 11);
+
+        CHECK(text.redo());
+        CHECK(text_of(text) == "hello ");
+        CHECK(cursor_of(text) == 6);
+
+        CHECK(text.redo());
+        CHECK(text_of(text) == "llo ");
+    }
+
+    /* A REPLACE record holds replacements that grow, shrink and delete text, and undoing it has to
+    account for the earlier ones having moved the later ones. */
+    void test_replace_round_trip(StorageKind kind)
+    {
+        const std::string original = "one two one\nthree one";
+        const std::string replaced = "1 two eins\nthree ";
+
+        TextBuffer text(kind);
+        text.insert(std::string_view(original));
+        text.set_cursor_pos(1, 2);
+
+        std::vector<Replacement> replacements = {{0, 3, "1"}, {8, 3, "eins"}, {18, 3, ""}};
+        text.replace(replacements);
+
+        CHECK(text_of(text) == replaced);
+        CHECK(text.get_line_count() == 2);
+
+        for (int round = 0; round < 2; round++)
+        {
+            CHECK(text.undo());
+            CHECK(text_of(text) == original);
+            CHECK(cursor_of(text) == 14);
+
+            CHECK(text.redo());
+            CHECK(text_of(text) == replaced);
+            CHECK(cursor_of(text) == 0);
+        }
+
+        /* Typing after the replace is undone first, without coalescing into it. */
+        text.set_cursor_pos(0, 1);
+        type(text, "st");
+        CHECK(text_of(text) == "1st two eins\nthree ");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == replaced);
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == original);
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "");
+        CHECK(!text.undo());
+
+        for (int i = 0; i < 3; i++)
+            CHECK(text.redo());
+
+        CHECK(text_of(text) == "1st two eins\nthree ");
+    }
+
+    /* A new edit after undoing means the undone edits can't be redone. */
+    void test_edit_discards_redo(StorageKind kind)
+    {
+        TextBuffer text(kind);
+        type(text, "abc\n");
+        type(text, "def");
+
+        CHECK(text.undo());
+        type(text, "x");
+
+        CHECK(!text.redo());
+        CHECK(text_of(text) == "abc\nx");
+
+        CHECK(text.undo());
+        CHECK(text_of(text) == "abc\n");
+    }
+}
+
+int main()
+{
+    for (StorageKind kind : {StorageKind::GAP_BUFFER, StorageKind::PIECE_TABLE})
+    {
+        test_typing_runs(kind);
+        test_cursor_move_ends_run(kind);
+        test_erase_runs(kind);
+        test_replace_round_trip(kind);
+        test_edit_discards_redo(kind);
+    }
+
+    return test::check_result();
+}
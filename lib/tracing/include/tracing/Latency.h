@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/* Times the rest of the enclosing scope, recording it in the histogram for stage. Like TRACE(),
+this compiles to nothing when tracing is compiled out. */
+#ifdef MANO_TRACE_ENABLED
+#define TRACING_CONCAT_INNER(a, b) a##b
+#define TRACING_CONCAT(a, b) TRACING_CONCAT_INNER(a, b)
+#define TIME_STAGE(stage) tracing::StageTimer TRACING_CONCAT(stage_timer_, __LINE__)(stage)
+#else
+#define TIME_STAGE(stage) \
+    do                    \
+    {                     \
+    } while (0)
+#endif
+
+namespace tracing
+{
+    /* The parts of handling a keystroke, from the key arriving to the screen being updated. */
+    enum class Stage
+    {
+        INPUT,    /* Decoding the key (or escape sequence / paste) after it arrives */
+        EDIT,     /* Changing the text storage */
+        METADATA, /* Updating the line metadata */
+        RENDER,   /* Drawing the windows and sending the output to the terminal */
+        FRAME     /* The whole thing, from the key arriving to the terminal being updated */
+    };
+
+    static constexpr int STAGE_COUNT = 5;
+
+    /* A histogram of durations in nanoseconds, in the style of HdrHistogram: each power of two is
+    split into SUB_BUCKETS linear buckets, so any value is reported to within 1/SUB_BUCKETS (~3%)
+    using a small fixed amount of memory, however large the values get. Recording is O(1).
+
+    Not thread-safe, so only record from one thread (in practice, the UI thread). */
+    class Histogram
+    {
+    public:
+        void record(std::int64_t value);
+        void reset();
+
+        std::int64_t count() const { return total_count; }
+        std::int64_t max() const { return max_value; }
+        double mean() const;
+
+        /* The value that percent% of the recorded values are at or below (to within a bucket). */
+        std::int64_t percentile(double percent) const;
+
+    private:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+        /* Values below SUB_BUCKETS get a bucket each, then every power of two above that gets
+        SUB_BUCKETS more. */
+        static constexpr int BUCKET_COUNT = SUB_BUCKETS * (64 - SUB_BUCKET_BITS);
+
+        std::array<std::int64_t, BUCKET_COUNT> counts = {};
+        std::int64_t total_count = 0;
+        std::int64_t total_value = 0;
+        std::int64_t max_value = 0;
+
+        static int bucket_index(std::int64_t value);
+
+        /* The largest value that falls into the bucket. */
+        static std::int64_t bucket_value(int index);
+    };
+
+    Histogram &histogram(Stage stage);
+
+    void record_latency(Stage stage, std::chrono::steady_clock::duration duration);
+
+    /* Records the lifetime of the timer. Use TIME_STAGE() rather than making these directly. */
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()) {};
+        ~StageTimer() { record_latency(stage, std::chrono::steady_clock::now() - start); }
+
+        StageTimer(const StageTimer &timer) = delete;
+        StageTimer &operator=(const StageTimer &timer) = delete;
+
+    private:
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /* Frames span several functions (from the key arriving to the terminal being updated), so are
+    timed by marking their start and end rather than with a scope. end_frame() does nothing unless
+    a frame has begun, so it can be called on every update. When several inputs are applied in one
+    frame, only the first begin_frame() counts, so the frame is timed from the oldest input. */
+    void begin_frame();
+    void end_frame();
+
+    void reset_latency();
+
+    /* A single line summary (e.g. for the command bar), with the median and 99th percentile of
+    each stage, e.g. "p50/p99 frame 95us/410us, input 2us/8us, ...". */
+    std::string latency_summary();
+
+    /* Writes the count, mean, max, and a spread of percentiles for every stage. */
+    void dump_latency(std::ostream &os);
+    bool dump_latency_to_file(const std::string &file_path);
+} /* namespace tracing */
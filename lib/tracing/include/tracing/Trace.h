@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+/* Records a printf-style message in the trace ring buffer, if level is enabled at runtime. When
+tracing is compiled out (MANO_TRACE=OFF), this expands to nothing and its arguments aren't evaluated. */
+#ifdef MANO_TRACE_ENABLED
+#define TRACE(level, ...)                        \
+    do                                           \
+    {                                            \
+        if (tracing::enabled(level))               \
+            tracing::record((level), __VA_ARGS__); \
+    } while (0)
+#else
+#define TRACE(level, ...) \
+    do                    \
+    {                     \
+    } while (0)
+#endif
+
+namespace tracing
+{
+    enum class Level
+    {
+        ERROR,
+        WARNING,
+        INFO,
+        DEBUG
+    };
+
+    /* The most recent RING_SIZE messages are kept in memory, each truncated to MESSAGE_SIZE. */
+    static constexpr int RING_SIZE = 4096;
+    static constexpr int MESSAGE_SIZE = 120;
+
+    extern std::atomic<int> current_level;
+
+    /* Messages more verbose than the current level are skipped with a single comparison. */
+    inline bool enabled(Level level)
+    {
+        return static_cast<int>(level) <= current_level.load(std::memory_order_relaxed);
+    }
+
+    void set_level(Level level);
+
+    /* Sets the level from the MANO_TRACE_LEVEL environment variable (error, warning, info, or
+    debug), if it's set. */
+    void set_level_from_env();
+
+    /* Use TRACE() rather than calling this directly. Safe to call from any thread. */
+    void record(Level level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /* Writes the ring buffer, oldest message first. */
+    void dump(std::ostream &os);
+    bool dump_to_file(const std::string &file_path);
+
+    /* Dumps the ring buffer to file_path if the program crashes (SIGSEGV, SIGBUS, SIGFPE, SIGILL,
+    or SIGABRT). Only async-signal-safe calls are made once the handler is running. */
+    void install_crash_handler(const std::string &file_path);
+} /* namespace tracing */
@@ -0,0 +1,201 @@
+#include "tracing/Latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace tracing
+{
+    namespace
+    {
+        std::array<Histogram, STAGE_COUNT> histograms;
+
+        bool frame_open = false;
+        std::chrono::steady_clock::time_point frame_start;
+
+        const char *stage_name(Stage stage)
+        {
+            switch (stage)
+            {
+            case Stage::INPUT:
+                return "input";
+            case Stage::EDIT:
+                return "edit";
+            case Stage::METADATA:
+                return "metadata";
+            case Stage::RENDER:
+                return "render";
+            default:
+                return "frame";
+            }
+        }
+
+        /* Formats nanoseconds with whichever unit keeps the number short. */
+        std::string format_duration(std::int64_t nanoseconds)
+        {
+            char text[32];
+
+            if (nanoseconds < 10'000)
+                std::snprintf(text, sizeof(text), "%lldns", static_cast<long long>(nanoseconds));
+            else if (nanoseconds < 10'000'000)
+                std::snprintf(text, sizeof(text), "%lldus", static_cast<long long>(nanoseconds / 1'000));
+            else
+                std::snprintf(text, sizeof(text), "%lldms", static_cast<long long>(nanoseconds / 1'000'000));
+
+            return text;
+        }
+    } /* namespace */
+
+    void Histogram::record(std::int64_t value)
+    {
+        value = std::max<std::int64_t>(value, 0);
+
+        counts[bucket_index(value)]++;
+        total_count++;
+        total_value += value;
+        max_value = std::max(max_value, value);
+    }
+
+    void Histogram::reset()
+    {
+        counts.fill(0);
+        total_count = 0;
+        total_value = 0;
+        max_value = 0;
+    }
+
+    double Histogram::mean() const
+    {
+        return total_count == 0 ? 0.0 : static_cast<double>(total_value) / static_cast<double>(total_count);
+    }
+
+    std::int64_t Histogram::percentile(double percent) const
+    {
+        if (total_count == 0)
+            return 0;
+
+        double fraction = std::clamp(percent, 0.0, 100.0) / 100.0;
+        std::int64_t target = std::max<std::int64_t>(1, static_cast<std::int64_t>(std::ceil(fraction * static_cast<double>(total_count))));
+        std::int64_t seen = 0;
+
+        for (int index = 0; index < BUCKET_COUNT; index++)
+        {
+            seen += counts[index];
+
+            if (seen >= target)
+                return std::min(bucket_value(index), max_value);
+        }
+
+        return max_value;
+    }
+
+    int Histogram::bucket_index(std::int64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return static_cast<int>(value);
+
+        /* The top SUB_BUCKET_BITS + 1 bits pick the bucket: the highest set bit picks the power of
+        two, and the bits below it pick the linear sub-bucket within it. */
+        int top_bit = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+        int shift = top_bit - SUB_BUCKET_BITS;
+
+        return SUB_BUCKETS * (shift + 1) + static_cast<int>((value >> shift) - SUB_BUCKETS);
+    }
+
+    std::int64_t Histogram::bucket_value(int index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+
+        int shift = index / SUB_BUCKETS - 1;
+        std::int64_t lowest = static_cast<std::int64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+
+        return lowest + (std::int64_t(1) << shift) - 1;
+    }
+
+    Histogram &histogram(Stage stage)
+    {
+        return histograms[static_cast<int>(stage)];
+    }
+
+    void record_latency(Stage stage, std::chrono::steady_clock::duration duration)
+    {
+        histogram(stage).record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    void begin_frame()
+    {
+        if (frame_open)
+            return;
+
+        frame_open = true;
+        frame_start = std::chrono::steady_clock::now();
+    }
+
+    void end_frame()
+    {
+        if (!frame_open)
+            return;
+
+        frame_open = false;
+        record_latency(Stage::FRAME, std::chrono::steady_clock::now() - frame_start);
+    }
+
+    void reset_latency()
+    {
+        for (Histogram &stage_histogram : histograms)
+            stage_histogram.reset();
+    }
+
+    std::string latency_summary()
+    {
+        /* Frame first, as it's the one that matters, then the stages that make it up. */
+        const Stage order[] = {Stage::FRAME, Stage::INPUT, Stage::EDIT, Stage::METADATA, Stage::RENDER};
+
+        std::string summary = "p50/p99";
+        const char *separator = " ";
+
+        for (Stage stage : order)
+        {
+            const Histogram &stage_histogram = histogram(stage);
+
+            summary += separator;
+            summary += stage_name(stage);
+            separator = ", ";
+            summary += " " + format_duration(stage_histogram.percentile(50)) + "/" + format_duration(stage_histogram.percentile(99));
+        }
+
+        return summary;
+    }
+
+    void dump_latency(std::ostream &os)
+    {
+        const double percentiles[] = {50, 90, 99, 99.9, 100};
+
+        for (int stage_num = 0; stage_num < STAGE_COUNT; stage_num++)
+        {
+            const Histogram &stage_histogram = histograms[stage_num];
+
+            os << stage_name(static_cast<Stage>(stage_num)) << ": count = " << stage_histogram.count()
+               << ", mean = " << format_duration(static_cast<std::int64_t>(stage_histogram.mean()))
+               << ", max = " << format_duration(stage_histogram.max());
+
+            for (double percent : percentiles)
+                os << ", p" << percent << " = " << format_duration(stage_histogram.percentile(percent));
+
+            os << std::endl;
+        }
+    }
+
+    bool dump_latency_to_file(const std::string &file_path)
+    {
+        std::ofstream file(file_path, std::ofstream::out | std::ofstream::trunc);
+
+        if (!file)
+            return false;
+
+        dump_latency(file);
+        return true;
+    }
+} /* namespace tracing */
@@ -0,0 +1,171 @@
+#include "tracing/Trace.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace tracing
+{
+    std::atomic<int> current_level = static_cast<int>(Level::INFO);
+
+    namespace
+    {
+        struct Entry
+        {
+            std::int64_t timestamp_us;
+            Level level;
+            char message[MESSAGE_SIZE];
+        };
+
+        Entry ring[RING_SIZE];
+        std::atomic<std::uint64_t> next_entry = 0;
+
+        const auto start_time = std::chrono::steady_clock::now();
+
+        char crash_file_path[4096] = "";
+
+        const char *level_name(Level level)
+        {
+            switch (level)
+            {
+            case Level::ERROR:
+                return "ERROR";
+            case Level::WARNING:
+                return "WARNING";
+            case Level::INFO:
+                return "INFO";
+            default:
+                return "DEBUG";
+            }
+        }
+
+        /* Calls fn for each entry still in the ring, oldest first. */
+        template <typename Fn>
+        void for_each_entry(Fn fn)
+        {
+            std::uint64_t end = next_entry.load();
+            std::uint64_t start = end > RING_SIZE ? end - RING_SIZE : 0;
+
+            for (std::uint64_t i = start; i < end; i++)
+                fn(ring[i % RING_SIZE]);
+        }
+
+        /* Only uses async-signal-safe functions, as this runs inside the crash handler. */
+        void write_entry(int fd, const Entry &entry)
+        {
+            /* Format the timestamp by hand, backwards from the end of the buffer. */
+            char timestamp[24];
+            int pos = sizeof(timestamp);
+            std::int64_t value = entry.timestamp_us;
+
+            do
+            {
+                timestamp[--pos] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value > 0 && pos > 0);
+
+            const char *name = level_name(entry.level);
+
+            write(fd, "[", 1);
+            write(fd, timestamp + pos, sizeof(timestamp) - pos);
+            write(fd, "us] ", 4);
+            write(fd, name, std::strlen(name));
+            write(fd, " ", 1);
+            write(fd, entry.message, strnlen(entry.message, MESSAGE_SIZE));
+            write(fd, "\n", 1);
+        }
+
+        void on_crash(int signal_num)
+        {
+            int fd = open(crash_file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            if (fd >= 0)
+            {
+                for_each_entry([fd](const Entry &entry)
+                               { write_entry(fd, entry); });
+
+                close(fd);
+            }
+
+            /* Let the default handler take it from here (e.g. to produce a core dump). */
+            std::signal(signal_num, SIG_DFL);
+            std::raise(signal_num);
+        }
+    } /* namespace */
+
+    void set_level(Level level)
+    {
+        current_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    void set_level_from_env()
+    {
+        const char *value = std::getenv("MANO_TRACE_LEVEL");
+
+        if (value == nullptr)
+            return;
+
+        const std::pair<const char *, Level> levels[] = {
+            {"error", Level::ERROR},
+            {"warning", Level::WARNING},
+            {"info", Level::INFO},
+            {"debug", Level::DEBUG},
+        };
+
+        for (auto [name, level] : levels)
+        {
+            if (std::strcmp(value, name) == 0)
+                set_level(level);
+        }
+    }
+
+    void record(Level level, const char *format, ...)
+    {
+        /* Claiming a slot is the only synchronisation. A slot can be torn if the ring wraps all the
+        way around while it's being written, which is an acceptable trade for a lock-free logger. */
+        Entry &entry = ring[next_entry.fetch_add(1, std::memory_order_relaxed) % RING_SIZE];
+
+        auto elapsed = std::chrono::steady_clock::now() - start_time;
+        entry.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        entry.level = level;
+
+        va_list args;
+        va_start(args, format);
+        std::vsnprintf(entry.message, MESSAGE_SIZE, format, args);
+        va_end(args);
+    }
+
+    void dump(std::ostream &os)
+    {
+        for_each_entry([&os](const Entry &entry)
+                       { os << "[" << entry.timestamp_us << "us] " << level_name(entry.level) << " "
+                            << std::string(entry.message, strnlen(entry.message, MESSAGE_SIZE)) << std::endl; });
+    }
+
+    bool dump_to_file(const std::string &file_path)
+    {
+        std::ofstream file(file_path, std::ofstream::out | std::ofstream::trunc);
+
+        if (!file)
+            return false;
+
+        dump(file);
+        return true;
+    }
+
+    void install_crash_handler(const std::string &file_path)
+    {
+        /* Copied up front, as allocating isn't safe inside a signal handler. */
+        std::snprintf(crash_file_path, sizeof(crash_file_path), "%s", file_path.c_str());
+
+        for (int signal_num : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+            std::signal(signal_num, on_crash);
+    }
+} /* namespace tracing */